@@ -0,0 +1,197 @@
+/// Check, and repair, the Nachos file system in a `DISK` file, without
+/// running Nachos.
+///
+/// Usage: `nachosfsck [-r] [-j THREADS] [DISK]`.
+///
+/// The size of the disk is taken from its superblock, and the rest of the
+/// file is read whole, in one sequential read.  The directory tree is
+/// walked first, then the file headers are split among `THREADS` threads
+/// (as many as processors by default), each counting the sectors used by
+/// its share; at the end, the counts are compared with the free map.  See
+/// `filesys/fsck.hh`.
+///
+/// With `-r`, the problems found are repaired: files that cannot be read,
+/// or that share sectors with another, are removed from their directory,
+/// and the free map is rebuilt.  Only the sectors changed are written
+/// back.  Nachos must not be running on the same `DISK` meanwhile.
+///
+/// The exit status is as for `fsck(8)`: 0 if nothing was wrong, 1 if
+/// problems were repaired, 4 if problems were left, 8 on other errors.
+///
+/// Copyright (c) 2018-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "filesys/fsck.hh"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/// Written by `Disk` at the start of the file, see `machine/disk.cc`.
+static const unsigned MAGIC_NUMBER = 0x456789AB;
+static const unsigned MAGIC_SIZE = sizeof (int);
+
+static const unsigned MAX_THREADS = 64;
+
+static pthread_mutex_t reportLock = PTHREAD_MUTEX_INITIALIZER;
+
+static void
+Report(const char *message)
+{
+    pthread_mutex_lock(&reportLock);
+    printf("%s\n", message);
+    pthread_mutex_unlock(&reportLock);
+}
+
+/// The share of the files checked by one thread.
+struct Worker {
+    pthread_t thread;
+    Fsck *fsck;
+    unsigned first;
+    unsigned last;
+    unsigned errors;
+    unsigned char *counts;
+};
+
+static void *
+CheckShare(void *arg)
+{
+    Worker *w = (Worker *) arg;
+    w->errors = w->fsck->CheckFiles(w->first, w->last, w->counts);
+    return nullptr;
+}
+
+static bool
+ReadAll(int fd, char *buffer, size_t size, off_t offset)
+{
+    while (size > 0) {
+        ssize_t n = pread(fd, buffer, size, offset);
+        if (n <= 0) {
+            return false;
+        }
+        buffer += n;
+        size -= n;
+        offset += n;
+    }
+    return true;
+}
+
+static void
+Usage(const char *program)
+{
+    fprintf(stderr, "Usage: %s [-r] [-j THREADS] [DISK]\n", program);
+    exit(8);
+}
+
+int
+main(int argc, char **argv)
+{
+    bool repair = false;
+    long numThreads = sysconf(_SC_NPROCESSORS_ONLN);
+    int option;
+    while ((option = getopt(argc, argv, "rj:")) != -1) {
+        switch (option) {
+            case 'r':
+                repair = true;
+                break;
+            case 'j':
+                numThreads = atol(optarg);
+                break;
+            default:
+                Usage(argv[0]);
+        }
+    }
+    if (argc - optind > 1) {
+        Usage(argv[0]);
+    }
+    const char *path = optind < argc ? argv[optind] : "DISK";
+    if (numThreads < 1) {
+        numThreads = 1;
+    } else if (numThreads > (long) MAX_THREADS) {
+        numThreads = MAX_THREADS;
+    }
+
+    int fd = open(path, repair ? O_RDWR : O_RDONLY);
+    if (fd == -1) {
+        perror(path);
+        return 8;
+    }
+    unsigned magic;
+    char super[SECTOR_SIZE];
+    unsigned numSectors = 0;
+    if (ReadAll(fd, (char *) &magic, MAGIC_SIZE, 0) && magic == MAGIC_NUMBER
+          && ReadAll(fd, super, SECTOR_SIZE, MAGIC_SIZE + SUPER_SECTOR * SECTOR_SIZE)) {
+        numSectors = Fsck::NumSectors(super);
+    }
+    if (numSectors == 0) {
+        fprintf(stderr, "%s: not a formatted Nachos disk of %u-byte sectors\n",
+                path, SECTOR_SIZE);
+        return 8;
+    }
+    size_t size = (size_t) numSectors * SECTOR_SIZE;
+    char *image = new char[size];
+    if (!ReadAll(fd, image, size, MAGIC_SIZE)) {
+        fprintf(stderr, "%s: shorter than its %u sectors\n", path, numSectors);
+        return 8;
+    }
+
+    Fsck *fsck = new Fsck(image, numSectors, Report);
+    unsigned errors = fsck->ReplayJournal();
+    if (fsck->IsChanged(JOURNAL_SECTOR)) {
+        printf("Operations left in the journal were finished.\n");
+    }
+    errors += fsck->ScanTree();
+
+    unsigned numFiles = fsck->NumFiles();
+    Worker *workers = new Worker[numThreads];
+    for (long i = 0; i < numThreads; i++) {
+        Worker *w = &workers[i];
+        w->fsck = fsck;
+        w->first = numFiles * i / numThreads;
+        w->last = numFiles * (i + 1) / numThreads;
+        w->counts = new unsigned char[numSectors]();
+        pthread_create(&w->thread, nullptr, CheckShare, w);
+    }
+    for (long i = 0; i < numThreads; i++) {
+        pthread_join(workers[i].thread, nullptr);
+        errors += workers[i].errors;
+        fsck->AddReferences(workers[i].counts);
+        delete [] workers[i].counts;
+    }
+    delete [] workers;
+    errors += fsck->CheckFreeMap();
+
+    printf("%u files, %u problems.\n", numFiles, errors);
+    int status = errors == 0 ? 0 : 4;
+    bool write = repair && fsck->IsChanged(JOURNAL_SECTOR);
+    if (repair && errors > 0) {
+        if (fsck->Repair()) {
+            status = 1;
+            write = true;
+        }
+    }
+    if (write) {
+        for (unsigned s = 0; s < numSectors; s++) {
+            if (fsck->IsChanged(s)
+                  && pwrite(fd, &image[s * SECTOR_SIZE], SECTOR_SIZE,
+                            MAGIC_SIZE + s * SECTOR_SIZE) != SECTOR_SIZE) {
+                perror(path);
+                return 8;
+            }
+        }
+        fsync(fd);
+        printf(status == 1 ? "Repaired.\n" : "Journal written back.\n");
+    }
+
+    delete fsck;
+    delete [] image;
+    close(fd);
+    return status;
+}
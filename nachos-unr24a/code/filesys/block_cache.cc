@@ -0,0 +1,588 @@
+/// Routines for the sector cache.
+///
+/// Copyright (c) 1992-1993 The Regents of the University of California.
+///               2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#include "block_cache.hh"
+#include "threads/system.hh"
+
+#include <string.h>
+
+static void FlusherThread(void *arg)
+{
+  ((BlockCache *)arg)->Flusher();
+}
+
+static void PrefetcherThread(void *arg)
+{
+  ((BlockCache *)arg)->Prefetcher();
+}
+
+BlockCache::BlockCache(SynchDisk *disk, unsigned n)
+{
+  ASSERT(disk != nullptr);
+  ASSERT(n > 0);
+
+  synchDisk = disk;
+  numBuffers = n;
+  buffers = new CacheBuffer[n];
+  for (unsigned i = 0; i < CACHE_BUCKETS; i++)
+    buckets[i] = nullptr;
+
+  lruHead = lruTail = nullptr;
+  for (unsigned i = 0; i < n; i++)
+  {
+    CacheBuffer *b = &buffers[i];
+    b->sector = -1;
+    b->valid = false;
+    b->dirty = false;
+    b->pins = 0;
+    b->lock = new Lock("cache buffer");
+    b->hashNext = nullptr;
+    LruPushFront(b);
+  }
+
+  cacheLock = new Lock("block cache");
+  bufferFree = new Condition("block cache buffer free", cacheLock);
+
+  numDirty = 0;
+  tickPending = false;
+  flushWanted = new Semaphore("block cache flush", 0);
+  Thread *flusher = new Thread("block cache flusher");
+  flusher->Fork(FlusherThread, this);
+
+  prefetchQueue = new List<CacheBuffer *>;
+  prefetchWanted = new Semaphore("block cache prefetch", 0);
+  Thread *prefetcher = new Thread("block cache read ahead");
+  prefetcher->Fork(PrefetcherThread, this);
+}
+
+BlockCache::~BlockCache()
+{
+  if (numDirty > 0)
+    DEBUG('f', "Cache: %u dirty buffers are lost\n", numDirty);
+  for (unsigned i = 0; i < numBuffers; i++)
+  {
+    ASSERT(buffers[i].pins == 0);
+    delete buffers[i].lock;
+  }
+  delete[] buffers;
+  delete bufferFree;
+  delete cacheLock;
+  delete flushWanted;
+  delete prefetchQueue;
+  delete prefetchWanted;
+}
+
+void BlockCache::ReadSector(int sector, char *data)
+{
+  ASSERT(data != nullptr);
+
+  if (journal != nullptr && journal->Read(sector, data))
+    return;
+  CacheBuffer *b = Get(sector);
+  memcpy(data, b->data, SECTOR_SIZE);
+  Release(b);
+}
+
+void BlockCache::WriteSector(int sector, const char *data)
+{
+  ASSERT(data != nullptr);
+
+  if (journal == nullptr || !journal->Log(sector, data))
+    Store(sector, data);
+}
+
+void BlockCache::ReadSectors(const int *sectors, unsigned count, char *data)
+{
+  ASSERT(sectors != nullptr && data != nullptr);
+
+  while (count > 0)
+  {
+    CacheBuffer *batch[CACHE_BATCH];
+    unsigned n = 0, size = Ascending(sectors, count);
+    for (unsigned i = 0; i < size; i++)
+    {
+      if (journal != nullptr && journal->Read(sectors[i], &data[i * SECTOR_SIZE]))
+        continue;
+      // Only wait for a buffer while holding none.
+      CacheBuffer *b = Claim(sectors[i], n == 0);
+      if (b == nullptr)
+      {
+        size = i;
+        break;
+      }
+      batch[n++] = b;
+    }
+    unsigned total = TakeQueued(batch, n);
+    FillAll(batch, total);
+    for (unsigned i = 0, j = 0; i < size; i++)
+      if (j < n && batch[j]->sector == sectors[i])
+      {
+        memcpy(&data[i * SECTOR_SIZE], batch[j]->data, SECTOR_SIZE);
+        Release(batch[j++]);
+      }
+    for (unsigned j = n; j < total; j++)
+      Release(batch[j]);
+    sectors += size;
+    data += size * SECTOR_SIZE;
+    count -= size;
+  }
+}
+
+void BlockCache::Store(int sector, const char *data)
+{
+  ASSERT(data != nullptr);
+
+  CacheBuffer *b = Get(sector, false);
+  memcpy(b->data, data, SECTOR_SIZE);
+  b->valid = true;
+  MarkDirty(b);
+  Release(b);
+}
+
+CacheBuffer *BlockCache::Get(int sector, bool fill)
+{
+  CacheBuffer *b = Claim(sector, true);
+  if (!b->valid && fill)
+  {
+    synchDisk->ReadSector(sector, b->data);
+    b->valid = true;
+  }
+  return b;
+}
+
+/// Pin and lock the buffer for `sector`, without reading it.  Returns null
+/// if every buffer is in use, unless `wait`.
+CacheBuffer *BlockCache::Claim(int sector, bool wait)
+{
+  ASSERT(0 <= sector && (unsigned)sector < synchDisk->GetNumSectors());
+
+  cacheLock->Acquire();
+  CacheBuffer *b;
+  for (;;)
+  {
+    if ((b = Lookup(sector)) != nullptr)
+    {
+      stats->numCacheHits++;
+      break;
+    }
+    if ((b = FindVictim()) != nullptr)
+    {
+      if (b->dirty)
+      {
+        // Its old contents must reach the disk before it is reused.  The
+        // pin keeps it from being taken while we write.
+        b->pins++;
+        cacheLock->Release();
+        b->lock->Acquire();
+        WriteBack(b);
+        b->lock->Release();
+        cacheLock->Acquire();
+        if (--b->pins == 0)
+          bufferFree->Signal();
+        continue;
+      }
+      stats->numCacheMisses++;
+      DEBUG('f', "Cache: sector %d replaces sector %d\n", sector, b->sector);
+      if (b->sector != -1)
+        HashRemove(b);
+      b->sector = sector;
+      b->valid = false;
+      HashInsert(b);
+      break;
+    }
+    if (!wait)
+    {
+      cacheLock->Release();
+      return nullptr;
+    }
+    // Every buffer is in use.
+    bufferFree->Wait();
+  }
+  b->pins++;
+  LruUnlink(b);
+  LruPushFront(b);
+  cacheLock->Release();
+
+  // The pin keeps the buffer from being given away while we wait.
+  b->lock->Acquire();
+  return b;
+}
+
+/// Read the buffers of `batch` that are not valid yet with one request.
+void BlockCache::FillAll(CacheBuffer **batch, unsigned count)
+{
+  int sectors[CACHE_BATCH];
+  char *data[CACHE_BATCH];
+  unsigned n = 0;
+  for (unsigned i = 0; i < count; i++)
+    if (!batch[i]->valid)
+    {
+      sectors[n] = batch[i]->sector;
+      data[n++] = batch[i]->data;
+    }
+  if (n == 0)
+    return;
+  synchDisk->ReadSectors(sectors, n, data);
+  for (unsigned i = 0; i < count; i++)
+    batch[i]->valid = true;
+}
+
+/// If some buffer of `batch` (the first `count`, locked) has to be read,
+/// add to it the buffers queued for read-ahead that follow it on disk, so
+/// that they are read in the same request instead of one after the other.
+/// The reader usually gets to a sector read ahead before the read-ahead
+/// thread does, since it runs without waiting while it finds the sectors
+/// before it in the cache.  Returns the new size of `batch`.
+unsigned BlockCache::TakeQueued(CacheBuffer **batch, unsigned count)
+{
+  bool needed = false;
+  for (unsigned i = 0; i < count; i++)
+    needed = needed || !batch[i]->valid;
+  if (!needed)
+    return count;
+
+  unsigned n = count;
+  cacheLock->Acquire();
+  while (n < CACHE_BATCH && !prefetchQueue->IsEmpty()
+         && prefetchQueue->Head()->sector > batch[n - 1]->sector)
+    batch[n++] = prefetchQueue->Pop();
+  cacheLock->Release();
+  // They keep the pin taken by `Prefetch`.
+  for (unsigned i = count; i < n; i++)
+    batch[i]->lock->Acquire();
+  return n;
+}
+
+/// Length of the ascending run `sectors` starts with, up to `CACHE_BATCH`.
+unsigned BlockCache::Ascending(const int *sectors, unsigned count)
+{
+  unsigned n = 1;
+  while (n < count && n < CACHE_BATCH && sectors[n] > sectors[n - 1])
+    n++;
+  return n;
+}
+
+void BlockCache::Release(CacheBuffer *b)
+{
+  ASSERT(b != nullptr);
+
+  b->lock->Release();
+  cacheLock->Acquire();
+  ASSERT(b->pins > 0);
+  if (--b->pins == 0)
+    bufferFree->Signal();
+  cacheLock->Release();
+}
+
+void BlockCache::MarkDirty(CacheBuffer *b)
+{
+  ASSERT(b != nullptr);
+  ASSERT(b->lock->IsHeldByCurrentThread());
+
+  cacheLock->Acquire();
+  if (!b->dirty)
+  {
+    b->dirty = true;
+    b->dirtySince = stats->totalTicks;
+    if (++numDirty > numBuffers / 2)
+      flushWanted->V();
+    ScheduleTick();
+  }
+  cacheLock->Release();
+}
+
+void BlockCache::Sync()
+{
+  Flush(0);
+}
+
+void BlockCache::SyncSector(int sector)
+{
+  SyncSectors(&sector, 1);
+}
+
+void BlockCache::SyncSectors(const int *sectors, unsigned count)
+{
+  ASSERT(sectors != nullptr);
+
+  while (count > 0)
+  {
+    unsigned size = Ascending(sectors, count);
+    CacheBuffer *batch[CACHE_BATCH];
+    unsigned n = 0;
+    cacheLock->Acquire();
+    for (unsigned i = 0; i < size; i++)
+    {
+      CacheBuffer *b = Lookup(sectors[i]);
+      if (b != nullptr && b->dirty)
+      {
+        b->pins++;
+        batch[n++] = b;
+      }
+    }
+    cacheLock->Release();
+
+    // Someone may have written some of them back meanwhile.
+    int dirtySectors[CACHE_BATCH];
+    const char *data[CACHE_BATCH];
+    unsigned m = 0;
+    for (unsigned i = 0; i < n; i++)
+    {
+      batch[i]->lock->Acquire();
+      if (batch[i]->dirty)
+      {
+        dirtySectors[m] = batch[i]->sector;
+        data[m++] = batch[i]->data;
+      }
+    }
+    if (m > 0)
+    {
+      synchDisk->WriteSectors(dirtySectors, m, data);
+      cacheLock->Acquire();
+      for (unsigned i = 0; i < n; i++)
+        if (batch[i]->dirty)
+        {
+          batch[i]->dirty = false;
+          numDirty--;
+        }
+      cacheLock->Release();
+    }
+    for (unsigned i = 0; i < n; i++)
+      Release(batch[i]);
+
+    sectors += size;
+    count -= size;
+  }
+}
+
+/// Write back every buffer that has been dirty for at least `minAge`
+/// ticks.
+///
+/// The sectors are sorted first, so that the disk head sweeps across them
+/// once instead of seeking back and forth.
+void BlockCache::Flush(unsigned long minAge)
+{
+  int *sectors = new int[numBuffers];
+  unsigned n = 0;
+
+  cacheLock->Acquire();
+  for (unsigned i = 0; i < numBuffers; i++)
+  {
+    CacheBuffer *b = &buffers[i];
+    if (!b->dirty || stats->totalTicks - b->dirtySince < minAge)
+      continue;
+    unsigned j = n++;
+    for (; j > 0 && sectors[j - 1] > b->sector; j--)
+      sectors[j] = sectors[j - 1];
+    sectors[j] = b->sector;
+  }
+  cacheLock->Release();
+
+  if (n > 0)
+  {
+    DEBUG('f', "Cache: flushing %u sectors\n", n);
+    SyncSectors(sectors, n);
+  }
+  delete[] sectors;
+}
+
+/// Write a pinned and locked buffer to the disk, if it is dirty.
+void BlockCache::WriteBack(CacheBuffer *b)
+{
+  if (!b->dirty)
+    return;
+  synchDisk->WriteSector(b->sector, b->data);
+  cacheLock->Acquire();
+  b->dirty = false;
+  numDirty--;
+  cacheLock->Release();
+}
+
+void BlockCache::Prefetch(int sector)
+{
+  Prefetch(&sector, 1);
+}
+
+void BlockCache::Prefetch(const int *sectors, unsigned count)
+{
+  ASSERT(sectors != nullptr);
+
+  unsigned queued = 0;
+  cacheLock->Acquire();
+  for (unsigned i = 0; i < count; i++)
+  {
+    int sector = sectors[i];
+    ASSERT(0 <= sector && (unsigned)sector < synchDisk->GetNumSectors());
+
+    // Guessing is not worth a write, nor waiting for a buffer.
+    CacheBuffer *b;
+    if (Lookup(sector) != nullptr || (b = FindVictim()) == nullptr || b->dirty)
+      continue;
+    stats->numReadAheads++;
+    DEBUG('f', "Cache: reading sector %d ahead\n", sector);
+    if (b->sector != -1)
+      HashRemove(b);
+    b->sector = sector;
+    b->valid = false;
+    HashInsert(b);
+    b->pins++;
+    LruUnlink(b);
+    LruPushFront(b);
+    prefetchQueue->Append(b);
+    queued++;
+  }
+  cacheLock->Release();
+  for (unsigned i = 0; i < queued; i++)
+    prefetchWanted->V();
+}
+
+void BlockCache::Prefetcher()
+{
+  for (;;)
+  {
+    // Take the run of ascending sectors at the front of the queue.  Other
+    // buffers of the run, and those taken by readers, leave their `V`
+    // behind, so the queue may be empty by now.
+    prefetchWanted->P();
+    CacheBuffer *batch[CACHE_BATCH];
+    unsigned n = 0;
+    int last = -1;
+    cacheLock->Acquire();
+    while (n < CACHE_BATCH && !prefetchQueue->IsEmpty()
+           && prefetchQueue->Head()->sector > last)
+    {
+      CacheBuffer *b = prefetchQueue->Pop();
+      last = b->sector;
+      if (b->lock->GetOwner() != nullptr)
+      {
+        // Someone needed it first and is reading it.  Waiting for them
+        // would let them get to the next sectors first too.
+        if (--b->pins == 0)
+          bufferFree->Signal();
+        continue;
+      }
+      batch[n++] = b;
+    }
+    cacheLock->Release();
+    if (n == 0)
+      continue;
+
+    // Someone may have needed a sector first and read it already.
+    for (unsigned i = 0; i < n; i++)
+      batch[i]->lock->Acquire();
+    FillAll(batch, n);
+    for (unsigned i = 0; i < n; i++)
+      Release(batch[i]);
+  }
+}
+
+void BlockCache::Flusher()
+{
+  for (;;)
+  {
+    flushWanted->P();
+
+    cacheLock->Acquire();
+    bool tooMany = numDirty > numBuffers / 2;
+    cacheLock->Release();
+    Flush(tooMany ? 0 : FLUSH_AGE);
+
+    // Keep looking while there is something left to write.
+    cacheLock->Acquire();
+    if (numDirty > 0)
+      ScheduleTick();
+    cacheLock->Release();
+  }
+}
+
+/// Arrange for the flusher to wake up in `FLUSH_INTERVAL` ticks.
+///
+/// The tick is scheduled as disk activity rather than as a timer, so that
+/// an idle machine still waits for pending write-backs before halting.
+void BlockCache::ScheduleTick()
+{
+  IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+  if (!tickPending)
+  {
+    tickPending = true;
+    interrupt->Schedule(FlushTick, this, FLUSH_INTERVAL, DISK_INT);
+  }
+  interrupt->SetLevel(oldLevel);
+}
+
+void BlockCache::FlushTick(void *arg)
+{
+  BlockCache *cache = (BlockCache *)arg;
+  cache->tickPending = false;
+  cache->flushWanted->V();
+}
+
+CacheBuffer *BlockCache::Lookup(int sector)
+{
+  for (CacheBuffer *b = buckets[sector % CACHE_BUCKETS]; b != nullptr; b = b->hashNext)
+    if (b->sector == sector)
+      return b;
+  return nullptr;
+}
+
+/// Least recently used buffer that nobody is using, if any.  Clean
+/// buffers are preferred, since they can be reused without writing.
+CacheBuffer *BlockCache::FindVictim()
+{
+  CacheBuffer *dirty = nullptr;
+  for (CacheBuffer *b = lruTail; b != nullptr; b = b->lruPrev)
+    if (b->pins == 0)
+    {
+      if (!b->dirty)
+        return b;
+      if (dirty == nullptr)
+        dirty = b;
+    }
+  return dirty;
+}
+
+void BlockCache::HashInsert(CacheBuffer *b)
+{
+  unsigned i = b->sector % CACHE_BUCKETS;
+  b->hashNext = buckets[i];
+  buckets[i] = b;
+}
+
+void BlockCache::HashRemove(CacheBuffer *b)
+{
+  CacheBuffer **p = &buckets[b->sector % CACHE_BUCKETS];
+  while (*p != b)
+  {
+    ASSERT(*p != nullptr);
+    p = &(*p)->hashNext;
+  }
+  *p = b->hashNext;
+  b->hashNext = nullptr;
+}
+
+void BlockCache::LruUnlink(CacheBuffer *b)
+{
+  if (b->lruPrev != nullptr)
+    b->lruPrev->lruNext = b->lruNext;
+  else
+    lruHead = b->lruNext;
+  if (b->lruNext != nullptr)
+    b->lruNext->lruPrev = b->lruPrev;
+  else
+    lruTail = b->lruPrev;
+}
+
+void BlockCache::LruPushFront(CacheBuffer *b)
+{
+  b->lruPrev = nullptr;
+  b->lruNext = lruHead;
+  if (lruHead != nullptr)
+    lruHead->lruPrev = b;
+  else
+    lruTail = b;
+  lruHead = b;
+}
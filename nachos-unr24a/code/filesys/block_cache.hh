@@ -0,0 +1,157 @@
+/// A cache of disk sectors, in front of `SynchDisk`.
+///
+/// Copyright (c) 1992-1993 The Regents of the University of California.
+///               2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_FILESYS_BLOCKCACHE__HH
+#define NACHOS_FILESYS_BLOCKCACHE__HH
+
+#include "synch_disk.hh"
+#include "threads/condition.hh"
+
+/// Number of sector buffers in the cache.
+const unsigned CACHE_SIZE = 64;
+
+/// Number of hash buckets used to look sectors up.
+const unsigned CACHE_BUCKETS = 32;
+
+/// A dirty buffer older than this many ticks is written back by the
+/// flusher.
+const unsigned long FLUSH_AGE = 50000;
+
+/// How often the flusher looks for old dirty buffers, in ticks.
+const unsigned long FLUSH_INTERVAL = 10000;
+
+/// Most buffers held at once to read or write several sectors with a
+/// single disk request.
+const unsigned CACHE_BATCH = 16;
+
+/// One sector worth of cached data.
+///
+/// A buffer is *pinned* while some thread uses it, and cannot be given to
+/// another sector until every pin is dropped.  Its contents are protected
+/// by its own lock, so that threads working on different sectors do not
+/// wait for each other.
+struct CacheBuffer
+{
+  int sector; ///< -1 if the buffer holds nothing.
+  bool valid; ///< `data` holds the contents of `sector`.
+  bool dirty; ///< `data` has not been written to the disk yet.
+  unsigned long dirtySince; ///< Tick of the first unwritten change.
+  unsigned pins;
+  Lock *lock;
+  char data[SECTOR_SIZE];
+
+  CacheBuffer *hashNext;          ///< Next buffer in the same bucket.
+  CacheBuffer *lruPrev, *lruNext; ///< Recency order, most recent first.
+};
+
+/// Sectors are looked up through a hash table and replaced in least
+/// recently used order.
+///
+/// Writes only mark the buffer dirty.  A flusher thread writes dirty
+/// buffers back, in ascending sector order, once they are `FLUSH_AGE` ticks
+/// old or when more than half the cache is dirty.  A dirty buffer chosen
+/// for replacement is written back first.
+///
+/// `Prefetch` claims a buffer for a sector that is about to be read and
+/// leaves the disk read to a read-ahead thread, so that the caller can go
+/// on.
+///
+/// Whenever several sectors are wanted at once (reads of a whole range,
+/// write-backs, read-ahead), the ones that need the disk are sent to it in
+/// a single request, up to `CACHE_BATCH` at a time.  Their buffers are
+/// locked in ascending sector order, so that threads doing this cannot
+/// end up waiting for each other.
+class BlockCache
+{
+public:
+  BlockCache(SynchDisk *disk, unsigned numBuffers = CACHE_SIZE);
+  ~BlockCache();
+
+  /// Same interface as `SynchDisk`.  Sectors written inside an operation
+  /// of the journal go to the journal instead, and are read from there
+  /// until it commits them.
+  void ReadSector(int sector, char *data);
+  void WriteSector(int sector, const char *data);
+
+  /// Read `sectors[i]` into `data + i * SECTOR_SIZE`, for `i` below
+  /// `count`.
+  void ReadSectors(const int *sectors, unsigned count, char *data);
+
+  /// Like `WriteSector`, bypassing the journal.
+  void Store(int sector, const char *data);
+
+  /// Pin the buffer for `sector` and lock it.  If `fill`, the buffer is
+  /// read from disk when it does not hold the sector yet; otherwise the
+  /// caller is about to overwrite it all.
+  CacheBuffer *Get(int sector, bool fill = true);
+
+  /// Unlock and unpin a buffer obtained with `Get`.
+  void Release(CacheBuffer *buffer);
+
+  /// Mark a buffer obtained with `Get` as modified.
+  void MarkDirty(CacheBuffer *buffer);
+
+  /// Write every dirty buffer back to the disk.
+  void Sync();
+
+  /// Write `sector` back to the disk, if it is cached and dirty.
+  void SyncSector(int sector);
+
+  /// Same, for each of `sectors`.
+  void SyncSectors(const int *sectors, unsigned count);
+
+  /// Start reading `sector` into the cache in the background, unless it
+  /// is cached already or no clean buffer is free for it.
+  void Prefetch(int sector);
+
+  /// Same, for each of `sectors`.  They are queued together, so that the
+  /// read-ahead thread can read them with one request.
+  void Prefetch(const int *sectors, unsigned count);
+
+  /// Body of the flusher thread.
+  void Flusher();
+
+  /// Body of the read-ahead thread.
+  void Prefetcher();
+
+private:
+  SynchDisk *synchDisk;
+  unsigned numBuffers;
+  CacheBuffer *buffers;
+  CacheBuffer *buckets[CACHE_BUCKETS];
+  CacheBuffer *lruHead, *lruTail;
+
+  Lock *cacheLock;       ///< Protects the hash table, LRU list, pins and
+                         ///< dirty flags.
+  Condition *bufferFree; ///< Signalled when a buffer loses its last pin.
+
+  unsigned numDirty;
+  bool tickPending;      ///< A `FlushTick` interrupt is scheduled.
+  Semaphore *flushWanted; ///< Wakes the flusher up.
+
+  List<CacheBuffer *> *prefetchQueue; ///< Pinned buffers waiting to be read.
+  Semaphore *prefetchWanted;          ///< At least one `V` per queued
+                                      ///< buffer.
+
+  void Flush(unsigned long olderThan);
+  void WriteBack(CacheBuffer *b);
+  unsigned Ascending(const int *sectors, unsigned count);
+  CacheBuffer *Claim(int sector, bool wait);
+  void FillAll(CacheBuffer **batch, unsigned count);
+  unsigned TakeQueued(CacheBuffer **batch, unsigned count);
+  void ScheduleTick();
+  static void FlushTick(void *arg);
+
+  CacheBuffer *Lookup(int sector);
+  CacheBuffer *FindVictim();
+  void HashInsert(CacheBuffer *b);
+  void HashRemove(CacheBuffer *b);
+  void LruUnlink(CacheBuffer *b);
+  void LruPushFront(CacheBuffer *b);
+};
+
+#endif
@@ -9,10 +9,8 @@
 /// ReadFrom/WriteBack to fetch the contents of the directory from disk, and
 /// to write back any modifications back to disk.
 ///
-/// Also, this implementation has the restriction that the size of the
-/// directory cannot expand.  In other words, once all the entries in the
-/// directory are used, no more files can be created.  Fixing this is one of
-/// the parts to the assignment.
+/// When all the entries are in use, the table doubles; the directory file
+/// is extended when the new entries are written back.
 ///
 /// Copyright (c) 1992-1993 The Regents of the University of California.
 ///               2016-2021 Docentes de la Universidad Nacional de Rosario.
@@ -23,11 +21,11 @@
 #include "directory_entry.hh"
 #include "file_header.hh"
 #include "lib/utility.hh"
+#include "name_cache.hh"
 #include "open_file.hh"
 
 #include <stdio.h>
 #include <string.h>
-#include <cstdlib>
 
 /// Initialize a directory; initially, the directory is completely empty.  If
 /// the disk is being formatted, an empty directory is all we need, but
@@ -37,13 +35,11 @@
 Directory::Directory(unsigned size, unsigned currentSector, unsigned parentSector)
 {
   ASSERT(size > 2);
-  raw.table = new DirectoryEntry[size];
-  raw.tableSize = size;
-
-  for (unsigned i = 2; i < raw.tableSize; i++)
-  {
-    raw.table[i].inUse = false;
-  }
+  raw.table = nullptr;
+  raw.tableSize = 0;
+  chain = nullptr;
+  dirty = nullptr;
+  Resize(size);
 
   DEBUG('f', "Creando directorio ./. (sector %u)\n", currentSector);
   raw.table[0].inUse = true;
@@ -56,12 +52,62 @@ Directory::Directory(unsigned size, unsigned currentSector, unsigned parentSecto
   strncpy(raw.table[1].name, "..", 4);
   raw.table[1].sector = parentSector;
   raw.table[1].isDir = true;
+
+  Index();
+  firstFree = 2;
 }
 
 /// De-allocate directory data structure.
 Directory::~Directory()
 {
   delete[] raw.table;
+  delete[] chain;
+  delete[] dirty;
+}
+
+/// Change the table to hold `size` entries, keeping the ones that fit.  New
+/// entries are free, and are written back as changed, so that the file
+/// grows with the table.
+void Directory::Resize(unsigned size)
+{
+  DirectoryEntry *table = new DirectoryEntry[size]();
+  unsigned kept = size < raw.tableSize ? size : raw.tableSize;
+  if (kept > 0)
+    memcpy(table, raw.table, kept * sizeof(DirectoryEntry));
+  delete[] raw.table;
+  raw.table = table;
+
+  unsigned numBlocks = DivRoundUp(size, DIR_ENTRIES_PER_SECTOR);
+  bool *newDirty = new bool[numBlocks];
+  for (unsigned b = 0; b < numBlocks; b++)
+    newDirty[b] = b * DIR_ENTRIES_PER_SECTOR >= kept || (dirty != nullptr && dirty[b]);
+  delete[] dirty;
+  dirty = newDirty;
+
+  raw.tableSize = size;
+  delete[] chain;
+  chain = new int[size];
+}
+
+void Directory::Touch(unsigned i)
+{
+  dirty[i / DIR_ENTRIES_PER_SECTOR] = true;
+}
+
+void Directory::Index()
+{
+  for (unsigned b = 0; b < NUM_BUCKETS; b++)
+    buckets[b] = -1;
+  for (unsigned i = 0; i < raw.tableSize; i++)
+    if (raw.table[i].inUse)
+      Link(i);
+}
+
+void Directory::Link(unsigned i)
+{
+  unsigned b = HashName(raw.table[i].name) % NUM_BUCKETS;
+  chain[i] = buckets[b];
+  buckets[b] = i;
 }
 
 /// Read the contents of the directory from disk.
@@ -70,18 +116,42 @@ Directory::~Directory()
 void Directory::FetchFrom(OpenFile *file)
 {
   ASSERT(file != nullptr);
+  unsigned size = file->Length() / sizeof(DirectoryEntry);
+  ASSERT(size > 2);
+  if (size != raw.tableSize)
+    Resize(size);
   file->ReadAt((char *)raw.table,
                raw.tableSize * sizeof(DirectoryEntry), 0);
+  for (unsigned b = 0; b < DivRoundUp(raw.tableSize, DIR_ENTRIES_PER_SECTOR); b++)
+    dirty[b] = false;
+  Index();
+  firstFree = 2;
 }
 
-/// Write any modifications to the directory back to disk.
+/// Write any modifications to the directory back to disk.  Only the sectors
+/// holding changed entries are written, a run of them at a time.
 ///
 /// * `file` is a file to contain the new directory contents.
 void Directory::WriteBack(OpenFile *file)
 {
   ASSERT(file != nullptr);
-  file->WriteAt((char *)raw.table,
-                raw.tableSize * sizeof(DirectoryEntry), 0);
+  unsigned numBlocks = DivRoundUp(raw.tableSize, DIR_ENTRIES_PER_SECTOR);
+  for (unsigned b = 0; b < numBlocks; b++)
+  {
+    if (!dirty[b])
+      continue;
+    unsigned end = b;
+    while (end < numBlocks && dirty[end])
+      dirty[end++] = false;
+    unsigned first = b * DIR_ENTRIES_PER_SECTOR;
+    unsigned last = end * DIR_ENTRIES_PER_SECTOR;
+    if (last > raw.tableSize)
+      last = raw.tableSize;
+    file->WriteAt((char *)&raw.table[first],
+                  (last - first) * sizeof(DirectoryEntry),
+                  first * sizeof(DirectoryEntry));
+    b = end;
+  }
 }
 
 /// Look up file name in directory, and return its location in the table of
@@ -92,9 +162,9 @@ int Directory::FindIndex(const char *name)
 {
   ASSERT(name != nullptr);
   DEBUG('f', "Looking for file %s, tableSize: %d\n", name, raw.tableSize);
-  for (unsigned i = 0; i < raw.tableSize; i++)
+  for (int i = buckets[HashName(name) % NUM_BUCKETS]; i != -1; i = chain[i])
   {
-    if (raw.table[i].inUse && !strncmp(raw.table[i].name, name, FILE_NAME_MAX_LEN))
+    if (!strncmp(raw.table[i].name, name, FILE_NAME_MAX_LEN))
     {
       return i;
     }
@@ -134,27 +204,27 @@ bool Directory::Add(const char *name, int newSector, bool isDir)
     return false;
   }
 
-  for (unsigned i = 2; i < raw.tableSize; i++)
+  unsigned i = firstFree;
+  while (i < raw.tableSize && raw.table[i].inUse)
+    i++;
+  if (i == raw.tableSize)
   {
-    if (!raw.table[i].inUse)
-    {
-      raw.table[i].inUse = true;
-      DEBUG('0', "Adding file %s at sector %u in %u\n", name, newSector, i);
-      strncpy(raw.table[i].name, name, FILE_NAME_MAX_LEN);
-      raw.table[i].sector = newSector;
-      raw.table[i].isDir = isDir;
-      return true;
-    }
+    // Expands the directory.
+    Resize(raw.tableSize * 2);
+    Index();
+    DEBUG('f', "Directory expanded to %d entries.\n", raw.tableSize);
   }
 
-  // Expands the directory.
-  raw.table = (DirectoryEntry *)realloc(raw.table,
-                                        ++raw.tableSize * sizeof(DirectoryEntry));
-  raw.table[raw.tableSize - 1].inUse = false;
-  DEBUG('f', "Directory expanded to %d entries.\n", raw.tableSize);
-  return Add(name, newSector, isDir);
-
-  // return false;  // no space.  Fix when we have extensible files.
+  raw.table[i].inUse = true;
+  DEBUG('0', "Adding file %s at sector %u in %u\n", name, newSector, i);
+  strncpy(raw.table[i].name, name, FILE_NAME_MAX_LEN);
+  raw.table[i].name[FILE_NAME_MAX_LEN] = '\0';
+  raw.table[i].sector = newSector;
+  raw.table[i].isDir = isDir;
+  Link(i);
+  Touch(i);
+  firstFree = i + 1;
+  return true;
 }
 
 /// Remove a file name from the directory.   Return true if successful;
@@ -171,6 +241,14 @@ bool Directory::Remove(const char *name)
     return false; // name not in directory
   }
   raw.table[i].inUse = false;
+  Touch(i);
+  if ((unsigned)i < firstFree)
+    firstFree = i;
+
+  int *p = &buckets[HashName(name) % NUM_BUCKETS];
+  while (*p != i)
+    p = &chain[*p];
+  *p = chain[i];
   return true;
 }
 
@@ -234,4 +312,9 @@ bool Directory::IsDir(const char *name)
 unsigned Directory::GetParentSector()
 {
   return raw.table[1].sector;
+}
+
+unsigned Directory::GetSector()
+{
+  return raw.table[0].sector;
 }
\ No newline at end of file
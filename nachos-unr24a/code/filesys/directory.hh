@@ -15,9 +15,14 @@
 #define NACHOS_FILESYS_DIRECTORY__HH
 
 #include "raw_directory.hh"
+#include "directory_entry.hh"
+#include "machine/disk.hh"
 
 class OpenFile;
 
+/// Entries are laid out so that none of them straddles two sectors.
+const unsigned DIR_ENTRIES_PER_SECTOR = SECTOR_SIZE / sizeof(DirectoryEntry);
+
 /// The following class defines a UNIX-like “directory”.  Each entry in the
 /// directory describes a file, and where to find it on disk.
 ///
@@ -27,6 +32,12 @@ class OpenFile;
 /// The constructor initializes a directory structure in memory; the
 /// `FetchFrom`/`WriteBack` operations shuffle the directory information
 /// from/to disk.
+///
+/// Names are found through a hash index of the entries, kept only in
+/// memory.  The table doubles when it runs out of free entries, and only
+/// the sectors of the directory file holding changed entries are written
+/// back, so that adding or removing a file writes a single sector however
+/// large the directory is.
 class Directory
 {
 public:
@@ -36,7 +47,8 @@ public:
   /// De-allocate the directory.
   ~Directory();
 
-  /// Initialize directory contents from disk.
+  /// Initialize directory contents from disk.  The table takes the size of
+  /// the file.
   void FetchFrom(OpenFile *file);
 
   /// Write modifications to directory contents back to disk.
@@ -67,10 +79,32 @@ public:
 
   unsigned GetParentSector();
 
+  /// Sector of this directory's own header.
+  unsigned GetSector();
+
 private:
+  static const unsigned NUM_BUCKETS = 16;
+
   /// Find the index into the directory table corresponding to `name`.
   int FindIndex(const char *name);
+
+  /// Rebuild the hash index from the table.
+  void Index();
+
+  /// Add entry `i` to the hash index.
+  void Link(unsigned i);
+
+  /// Make room for `size` entries.
+  void Resize(unsigned size);
+
+  /// Entry `i` changed.
+  void Touch(unsigned i);
+
   RawDirectory raw;
+  int buckets[NUM_BUCKETS]; ///< First entry in each bucket, or -1.
+  int *chain;               ///< Next entry in the same bucket, by entry.
+  bool *dirty;              ///< Sectors of the table not written yet.
+  unsigned firstFree;       ///< No free entry comes before this one.
 };
 
 #endif
@@ -1,9 +1,9 @@
 #include "directoryTable.hh"
 #include <string.h>
 #include "lib/utility.hh"
-#include "file_header.hh"
+#include "file_system.hh"
 #include "synchDirectory.hh"
-#include "threads/lock.hh"
+#include "threads/rw_lock.hh"
 DirectoryTable::DirectoryTable()
 {
   table = new Table<DirectoryInfo *>;
@@ -17,17 +17,17 @@ int DirectoryTable::AddDirectory(const char *name, OpenFile *file, unsigned curr
 {
   int id;
 
-  if (name && (id = Find(name)) != -1)
+  if ((id = FindBySector(currentSector)) != -1)
     return id;
 
   DirectoryInfo *info = new DirectoryInfo;
-  Lock *lock = new Lock(name);
+  RWLock *lock = new RWLock(name);
 
-  SynchDirectory *synchDir = new SynchDirectory(10, lock, currentSector, parentSector);
+  SynchDirectory *synchDir = new SynchDirectory(NUM_DIR_ENTRIES, lock, currentSector, parentSector);
   info->synchDir = synchDir;
 
   info->file = file;
-  info->size = 10;
+  info->size = NUM_DIR_ENTRIES;
   info->available = true;
   info->nThreads = 1;
   if (name)
@@ -36,8 +36,7 @@ int DirectoryTable::AddDirectory(const char *name, OpenFile *file, unsigned curr
     strncpy(info->name, aux, FILE_NAME_MAX_LEN);
   }
 
-  if ((id = table->Add(info)) == -1)
-    delete info;
+  id = table->Add(info, currentSector);
   DEBUG('f', "'DirectoryTable::AddDirectory'name: %s,  id directory: %d\n", info->name, id);
   return id;
 }
@@ -48,45 +47,12 @@ void DirectoryTable::RemoveDirectory(int id)
   info->file = NULL;
   delete info;
 }
-int DirectoryTable::Find(const char *name)
+int DirectoryTable::FindBySector(unsigned sector)
 {
-  ASSERT(name != nullptr);
-
-  for (unsigned i = 0; i < table->SIZE; i++)
-  {
-    if (table->HasKey(i) && strncmp(table->Get(i)->name, name, FILE_NAME_MAX_LEN) == 0)
-      return i;
-  }
-  return -1;
-}
-
-int DirectoryTable::FindFID(int fid)
-{
-  for (unsigned i = 0; i < table->SIZE; i++)
-  {
-    if (table->HasKey(i) && table->Get(i)->file->GetId() == fid)
-      return i;
-  }
-  return -1;
+  return table->Find(sector);
 }
 
 DirectoryInfo *DirectoryTable::GetDirectoryInfo(int id)
 {
   return table->Get(id);
 }
-
-DirectoryInfo *DirectoryTable::GetDirectoryInfo2(OpenFile *file)
-{
-  DEBUG('z', "Table Size %u\n", table->SIZE);
-  for (unsigned i = 0; i < table->SIZE; i++)
-  {
-    if (table->HasKey(i))
-      DEBUG('z', "Comparing %p with %p\n", table->Get(i)->file, file);
-    if (table->HasKey(i) && table->Get(i)->file->GetId() == file->GetId())
-    {
-      DEBUG('z', "equal %d\n", i);
-      return table->Get(i);
-    }
-  }
-  return nullptr;
-}
\ No newline at end of file
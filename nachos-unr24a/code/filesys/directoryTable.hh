@@ -29,13 +29,12 @@ public:
   int AddDirectory(const char *name, OpenFile *file, unsigned currentSector, unsigned parentSector);
   void RemoveDirectory(int id);
 
-  int Find(const char *name);
-  int FindFID(int fid);
+  int FindBySector(unsigned sector);
 
   DirectoryInfo *GetDirectoryInfo(int id);
-  DirectoryInfo *GetDirectoryInfo2(OpenFile *file);
 
 private:
+  /// Directories by id, keyed by the sector of their header.
   Table<DirectoryInfo *> *table;
 };
 
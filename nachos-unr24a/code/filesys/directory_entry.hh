@@ -6,8 +6,9 @@
 #ifndef NACHOS_FILESYS_DIRECTORYENTRY__HH
 #define NACHOS_FILESYS_DIRECTORYENTRY__HH
 
-/// For simplicity, we assume file names are <= 9 characters long.
-const unsigned FILE_NAME_MAX_LEN = 9;
+/// Maximum length of a file name.  It is chosen so that an entry takes 32
+/// bytes, and a sector holds a whole number of them.
+const unsigned FILE_NAME_MAX_LEN = 25;
 
 /// The following class defines a "directory entry", representing a file in
 /// the directory.  Each entry gives the name of the file, and where the
@@ -18,14 +19,13 @@ const unsigned FILE_NAME_MAX_LEN = 9;
 class DirectoryEntry
 {
 public:
-  /// Is this directory entry in use?
-  bool inUse;
   /// Location on disk to find the `FileHeader` for this file.
   unsigned sector;
+  /// Is this directory entry in use?
+  bool inUse;
+  bool isDir;
   /// Text name for file, with +1 for the trailing `'\0'`.
   char name[FILE_NAME_MAX_LEN + 1];
-
-  bool isDir;
 };
 
 #endif
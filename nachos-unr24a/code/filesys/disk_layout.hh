@@ -0,0 +1,88 @@
+/// Where the file system keeps its own structures on disk.
+///
+/// Kept apart from the classes that use them, so that tools running
+/// outside of Nachos (see `bin/fsck`) can read a `DISK` file too.
+///
+/// Copyright (c) 1992-1993 The Regents of the University of California.
+///               2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_FILESYS_DISKLAYOUT__HH
+#define NACHOS_FILESYS_DISKLAYOUT__HH
+
+#include "raw_file_header.hh"
+#include "machine/disk.hh"
+
+/// Sector holding the superblock, which tells the geometry the disk was
+/// formatted with.  Nachos reads it first thing at boot, and sets the disk
+/// to that geometry.
+const unsigned SUPER_SECTOR = 0;
+
+/// Sectors containing the file headers for the bitmap of free sectors, and
+/// the root directory.  These file headers are placed in well-known
+/// sectors, so that they can be located on boot-up.
+const unsigned FREE_MAP_SECTOR = 1;
+const unsigned DIRECTORY_SECTOR = 2;
+
+/// First sector of the journal area, right after the headers of the free
+/// map and the root directory.
+const unsigned JOURNAL_SECTOR = 3;
+
+/// Sectors taken by the journal area.
+const unsigned JOURNAL_SECTORS = 64;
+
+/// Tells a formatted disk from whatever was in the `DISK` file before.
+const unsigned SUPER_MAGIC = 0x4E414348;
+
+/// Value of `SuperBlock::state` once Nachos stopped without leaving any
+/// sector taken ahead of the writes (see `FileSystem::Shutdown`).
+const unsigned SUPER_CLEAN = 0x434C4E;
+
+/// Contents of the superblock.
+///
+/// The sector size is fixed when Nachos is compiled, since the file headers
+/// and indirection tables take one sector each; it is recorded anyway, so
+/// that a disk is not used by a Nachos built for another size.
+struct SuperBlock
+{
+  unsigned magic;
+  unsigned sectorSize;
+  unsigned sectorsPerTrack;
+  unsigned numTracks;
+  unsigned state;  ///< `SUPER_CLEAN`, or anything else if not.
+};
+
+/// Bounds on the size of a disk: room for the sectors above plus a few
+/// files, and a free map that fits in a file.
+const unsigned MIN_NUM_SECTORS = 2 * (JOURNAL_SECTOR + JOURNAL_SECTORS);
+const unsigned MAX_NUM_SECTORS = MAX_FILE_SIZE * BITS_IN_BYTE;
+
+/// Size of the free map file of a disk with `numSectors` sectors: the
+/// bitmap is kept in whole words.
+inline unsigned
+FreeMapSize(unsigned numSectors)
+{
+  return DivRoundUp(numSectors, BITS_IN_WORD) * sizeof(unsigned);
+}
+
+/// The area starts with a header sector and the sectors that tell where
+/// each logged sector belongs; the rest are slots for logged sectors.
+const unsigned JOURNAL_MAP_ENTRIES = SECTOR_SIZE / sizeof(int);
+const unsigned JOURNAL_MAP_SECTORS =
+  (JOURNAL_SECTORS + JOURNAL_MAP_ENTRIES - 1) / JOURNAL_MAP_ENTRIES;
+const unsigned JOURNAL_SLOTS = JOURNAL_SECTORS - 1 - JOURNAL_MAP_SECTORS;
+const unsigned JOURNAL_FIRST_MAP = JOURNAL_SECTOR + 1;
+const unsigned JOURNAL_FIRST_SLOT = JOURNAL_FIRST_MAP + JOURNAL_MAP_SECTORS;
+
+/// Tells a journal from whatever was on the disk before.
+const unsigned JOURNAL_MAGIC = 0x4A524E4C;
+
+/// Contents of the first sector of the journal area.
+struct JournalHeader
+{
+  unsigned magic;
+  unsigned count;  ///< Slots holding committed sectors.
+};
+
+#endif
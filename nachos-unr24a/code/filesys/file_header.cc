@@ -27,9 +27,22 @@
 
 #include <ctype.h>
 #include <stdio.h>
-#include "synch_disk.hh"
+#include "block_cache.hh"
+extern BlockCache *blockCache;
 extern SynchDisk *synchDisk;
 
+FileHeader::FileHeader()
+{
+  raw.numBytes = 0;
+  rawDirty = false;
+  numAllocated = 0;
+  for (unsigned i = 0; i < NUM_INDIRECT; i++)
+  {
+    tableLoaded[i] = false;
+    tableDirty[i] = false;
+  }
+}
+
 unsigned FileHeader::GetNumSectors()
 {
   return DivRoundUp(raw.numBytes, SECTOR_SIZE);
@@ -40,18 +53,71 @@ unsigned FileHeader::GetNumTables()
   return DivRoundUp(GetNumSectors(), NUM_DIRECT);
 }
 
-unsigned FileHeader::GetInitSector()
+/// Read table `i` from disk, unless it is already in memory.
+void FileHeader::LoadTable(unsigned i)
+{
+  ASSERT(i < DivRoundUp(numAllocated, NUM_DIRECT));
+  if (!tableLoaded[i])
+  {
+    blockCache->ReadSector(raw.tableSectors[i], (char *)&indirectTables[i]);
+    tableLoaded[i] = true;
+  }
+}
+
+const IndirectionTable *FileHeader::GetTable(unsigned i)
 {
-  return indirectTables[0].dataSectors[0] - (sizeof(int));
+  LoadTable(i);
+  return &indirectTables[i];
+}
+
+/// Take `count` free sectors out of `freeMap`, trying to keep them
+/// contiguous, and store their numbers in `sectors`.
+///
+/// Runs are looked for from `goal` onwards first (next fit), so that a file
+/// that grows continues where it left off.  If `trackAware`, a run short
+/// enough to fit in a track is placed within one, since the disk buffers a
+/// whole track at a time.  When free space is too fragmented for a single
+/// run, the free extents following `goal` are taken in order.
+///
+/// The caller must have checked that there are enough free sectors.
+static void TakeSectors(Bitmap *freeMap, unsigned *sectors, unsigned count,
+                        unsigned goal, bool trackAware)
+{
+  unsigned numSectors = freeMap->GetNumBits();
+  unsigned boundary = trackAware ? synchDisk->GetSectorsPerTrack() : 0;
+  unsigned taken = 0;
+  goal %= numSectors;
+  while (taken < count)
+  {
+    unsigned want = count - taken, length = want;
+    int start = freeMap->FindContiguous(want, goal, boundary);
+    if (start == -1 && goal > 0)
+      start = freeMap->FindContiguous(want, 0, boundary);
+    if (start == -1)
+    {
+      start = freeMap->FindFrom(goal);
+      ASSERT(start != -1);
+      for (length = 1; length < want && start + length < numSectors && !freeMap->Test(start + length); length++)
+        freeMap->Mark(start + length);
+    }
+    for (unsigned i = 0; i < length; i++)
+      sectors[taken++] = start + i;
+    goal = (start + length) % numSectors;
+  }
 }
 
 /// Initialize a fresh file header for a newly created file.  Allocate data
 /// blocks for the file out of the map of free disk blocks.  Return false if
 /// there are not enough free blocks to accomodate the new file.
 ///
+/// The indirection tables are placed first and the data right after them,
+/// in a single run if possible, so that reading the file does not seek.
+///
 /// * `freeMap` is the bit map of free disk sectors.
 /// * `fileSize` is the bit map of free disk sectors.
-bool FileHeader::Allocate(Bitmap *freeMap, unsigned fileSize)
+/// * `goal` is where to start looking for space, usually right after the
+///   header.
+bool FileHeader::Allocate(Bitmap *freeMap, unsigned fileSize, unsigned goal)
 {
   ASSERT(freeMap != nullptr);
 
@@ -68,24 +134,18 @@ bool FileHeader::Allocate(Bitmap *freeMap, unsigned fileSize)
     return false; // Not enough space.
   }
 
+  unsigned *sectors = new unsigned[numTables + numSectors];
+  TakeSectors(freeMap, sectors, numTables + numSectors, goal, true);
   for (unsigned i = 0; i < numTables; i++)
   {
-    raw.tableSectors[i] = freeMap->Find();
-    unsigned size = numSectors < NUM_DIRECT ? numSectors : NUM_DIRECT;
-
-    for (unsigned j = 0; j < size; j++)
-    {
-      indirectTables[i].dataSectors[j] = freeMap->Find();
-    }
-    numSectors -= NUM_DIRECT;
+    raw.tableSectors[i] = sectors[i];
+    tableLoaded[i] = tableDirty[i] = true;
   }
-
-  // for (unsigned j = 0, indexDirtable = 0; j < numSectors; j++)
-  // {
-  //   unsigned index = DivRoundDown(j, NUM_DIRECT);
-  //   indirectTables[index].dataSectors[indexDirtable++] = freeMap->Find();
-  //   indexDirtable %= NUM_DIRECT;
-  // }
+  rawDirty = true;
+  for (unsigned j = 0; j < numSectors; j++)
+    indirectTables[j / NUM_DIRECT].dataSectors[j % NUM_DIRECT] = sectors[numTables + j];
+  delete[] sectors;
+  numAllocated = numSectors;
 
   return true;
 }
@@ -96,12 +156,13 @@ bool FileHeader::Allocate(Bitmap *freeMap, unsigned fileSize)
 void FileHeader::Deallocate(Bitmap *freeMap)
 {
   ASSERT(freeMap != nullptr);
-  unsigned numSectors = GetNumSectors();
-  unsigned numTables = GetNumTables();
+  unsigned numSectors = numAllocated;
+  unsigned numTables = DivRoundUp(numAllocated, NUM_DIRECT);
 
   for (unsigned i = 0; i < numTables; i++)
   {
     unsigned size = numSectors < NUM_DIRECT ? numSectors : NUM_DIRECT;
+    LoadTable(i);
     for (unsigned j = 0; j < size; j++)
     {
       ASSERT(freeMap->Test(indirectTables[i].dataSectors[j])); // ought to be marked!
@@ -118,10 +179,11 @@ void FileHeader::Deallocate(Bitmap *freeMap)
 /// * `sector` is the disk sector containing the file header.
 void FileHeader::FetchFrom(unsigned sector)
 {
-  synchDisk->ReadSector(sector, (char *)&raw);
-  unsigned numTables = GetNumTables();
-  for (unsigned i = 0; i < numTables; i++)
-    synchDisk->ReadSector(raw.tableSectors[i], (char *)&indirectTables[i]);
+  blockCache->ReadSector(sector, (char *)&raw);
+  rawDirty = false;
+  numAllocated = GetNumSectors();
+  for (unsigned i = 0; i < NUM_INDIRECT; i++)
+    tableLoaded[i] = tableDirty[i] = false;
 }
 
 /// Write the modified contents of the file header back to disk.
@@ -129,10 +191,41 @@ void FileHeader::FetchFrom(unsigned sector)
 /// * `sector` is the disk sector to contain the file header.
 void FileHeader::WriteBack(unsigned sector)
 {
-  synchDisk->WriteSector(sector, (char *)&raw);
+  if (rawDirty)
+  {
+    blockCache->WriteSector(sector, (char *)&raw);
+    rawDirty = false;
+  }
   unsigned numTables = GetNumTables();
   for (unsigned i = 0; i < numTables; i++)
-    synchDisk->WriteSector(raw.tableSectors[i], (char *)&indirectTables[i]);
+    if (tableDirty[i])
+    {
+      blockCache->WriteSector(raw.tableSectors[i], (char *)&indirectTables[i]);
+      tableDirty[i] = false;
+    }
+}
+
+/// Force the delayed writes of this file's data blocks and indirection
+/// tables out of the block cache.  The header sector itself is not known
+/// here; the caller syncs it.
+///
+/// Tables that were never loaded are skipped: nothing was written through
+/// them.
+void FileHeader::Sync()
+{
+  unsigned numSectors = GetNumSectors();
+  unsigned numTables = GetNumTables();
+  for (unsigned i = 0; i < numTables; i++, numSectors -= NUM_DIRECT)
+  {
+    if (!tableLoaded[i])
+      continue;
+    unsigned size = numSectors < NUM_DIRECT ? numSectors : NUM_DIRECT;
+    int sectors[NUM_DIRECT + 1];
+    for (unsigned j = 0; j < size; j++)
+      sectors[j] = indirectTables[i].dataSectors[j];
+    sectors[size] = raw.tableSectors[i];
+    blockCache->SyncSectors(sectors, size + 1);
+  }
 }
 
 /// Return which disk sector is storing a particular byte within the file.
@@ -149,6 +242,7 @@ FileHeader::ByteToSector(unsigned offset)
   unsigned offset2 = offset - (nTable * NUM_DIRECT * SECTOR_SIZE);
   unsigned index = DivRoundDown(offset2, SECTOR_SIZE);
 
+  LoadTable(nTable);
   return indirectTables[nTable].dataSectors[index];
 }
 
@@ -188,7 +282,7 @@ void FileHeader::Print(const char *title)
   {
     unsigned sector = ByteToSector(i * SECTOR_SIZE);
     printf("    contents of block %u:\n", sector);
-    synchDisk->ReadSector(sector, data);
+    blockCache->ReadSector(sector, data);
     for (unsigned j = 0; j < SECTOR_SIZE && k < raw.numBytes; j++, k++)
     {
       if (isprint(data[j]))
@@ -211,52 +305,118 @@ FileHeader::GetRaw() const
   return &raw;
 }
 
-bool FileHeader::Extend(unsigned newSize, Bitmap *bitMap)
+/// Grow the file to `newSize` bytes.  Return false if there is not enough
+/// free space.
+///
+/// When the file needs new sectors, it takes about as many again as it
+/// already has (between `GROWTH_MIN` and `GROWTH_MAX`), so that a file
+/// written by small appends is extended only a few times and its blocks
+/// stay together.  While `newSize` fits in what was already taken, the
+/// free map is not touched and `bitMap` may be null.  `Trim` gives back
+/// what ends up unused.  Files that are never closed, like directories,
+/// would keep those sectors forever, so they pass `preallocate` as false.
+bool FileHeader::Extend(unsigned newSize, Bitmap *bitMap, bool preallocate)
 {
   ASSERT(newSize > raw.numBytes);
   DEBUG('f', "Extending file to %u bytes.\n", newSize);
-  unsigned numSectors = GetNumSectors();
-  unsigned numTables = GetNumTables();
-  unsigned totalSectors = numSectors + numTables;
+  if (newSize > MAX_FILE_SIZE)
+    return false;
+
+  if (NeedsSectors(newSize))
+  {
+    ASSERT(bitMap != nullptr);
+    unsigned newNumSectors = DivRoundUp(newSize, SECTOR_SIZE);
+    unsigned growth = numAllocated < GROWTH_MIN   ? GROWTH_MIN
+                      : numAllocated > GROWTH_MAX ? GROWTH_MAX
+                                                  : numAllocated;
+    unsigned target = preallocate ? newNumSectors + growth : newNumSectors;
+    if (target > MAX_FILE_SIZE / SECTOR_SIZE)
+      target = MAX_FILE_SIZE / SECTOR_SIZE;
+    // Without room for the extra sectors, take just what is needed.
+    if (!Grow(target, bitMap) && !Grow(newNumSectors, bitMap))
+      return false;
+  }
+
+  raw.numBytes = newSize;
+  rawDirty = true;
+  return true;
+}
+
+bool FileHeader::NeedsSectors(unsigned newSize) const
+{
+  return DivRoundUp(newSize, SECTOR_SIZE) > numAllocated;
+}
 
-  unsigned newNumSectors = DivRoundUp(newSize, SECTOR_SIZE);
-  unsigned newNumTables = DivRoundUp(newNumSectors, NUM_DIRECT);
+bool FileHeader::HasPreallocated() const
+{
+  return numAllocated > DivRoundUp(raw.numBytes, SECTOR_SIZE);
+}
 
-  unsigned newTotalSectors = newNumSectors + newNumTables;
+/// Take data sectors until the file holds `target` of them, plus the
+/// tables to point to them.  Nothing is taken if they do not all fit.
+bool FileHeader::Grow(unsigned target, Bitmap *bitMap)
+{
+  unsigned numTables = DivRoundUp(numAllocated, NUM_DIRECT);
+  unsigned newNumTables = DivRoundUp(target, NUM_DIRECT);
+  unsigned newData = target - numAllocated;
+  unsigned newTables = newNumTables - numTables;
 
-  if (numSectors == newNumSectors)
+  if (bitMap->CountClear() < newData + newTables)
   {
-    raw.numBytes = newSize; // no new sectors required
-    return true;
+    DEBUG('f', "Not enough space to grow file to %u sectors.\n", target);
+    return false;
   }
 
-  if (bitMap->CountClear() < newTotalSectors - totalSectors)
+  // The new data continues right after the last block, and new tables go
+  // after the new data, so that they do not break the run.  The last table
+  // is loaded first, as it may get new entries.
+  unsigned *sectors = new unsigned[newData + newTables];
+  unsigned goal = 0;
+  if (numAllocated > 0)
   {
-    DEBUG('f', "Not enough space to extend file. NewSectors: %u, numSectors: %u, total: %u\n", newTotalSectors, totalSectors, newTotalSectors - totalSectors);
-    return false; // Not enough space.
+    unsigned last = numAllocated - 1;
+    LoadTable(last / NUM_DIRECT);
+    goal = indirectTables[last / NUM_DIRECT].dataSectors[last % NUM_DIRECT] + 1;
   }
+  TakeSectors(bitMap, sectors, newData, goal, numAllocated == 0);
+  TakeSectors(bitMap, sectors + newData, newTables, sectors[newData - 1] + 1, false);
 
-  // Create new indirection tables if necessary
   for (unsigned i = numTables; i < newNumTables; i++)
   {
-    raw.tableSectors[i] = bitMap->Find();
+    raw.tableSectors[i] = sectors[newData + i - numTables];
+    tableLoaded[i] = true;
   }
+  for (unsigned i = numAllocated; i < target; i++)
+  {
+    indirectTables[i / NUM_DIRECT].dataSectors[i % NUM_DIRECT] = sectors[i - numAllocated];
+    tableDirty[i / NUM_DIRECT] = true;
+  }
+  delete[] sectors;
 
-  // Find the index in the table where we should start writing
+  numAllocated = target;
+  return true;
+}
 
-  unsigned tableNum = DivRoundDown(numSectors, NUM_DIRECT);
-  unsigned offsetInTable = raw.numBytes - (tableNum * NUM_DIRECT * SECTOR_SIZE);
-  unsigned indexInTable = DivRoundDown(offsetInTable, SECTOR_SIZE);
+/// Give back to `bitMap` the sectors preallocated past the end of the file,
+/// and the tables that only pointed to them.  Return true if there were
+/// any, in which case the free map has to be written back.
+bool FileHeader::Trim(Bitmap *bitMap)
+{
+  ASSERT(bitMap != nullptr);
+  if (!HasPreallocated())
+    return false;
+  unsigned numSectors = GetNumSectors();
+  unsigned numTables = GetNumTables();
 
-  // Add missing sectors
-  for (unsigned i = numSectors; i < newNumSectors; i++)
+  DEBUG('f', "Trimming %u preallocated sectors.\n", numAllocated - numSectors);
+  unsigned allocatedTables = DivRoundUp(numAllocated, NUM_DIRECT);
+  for (unsigned i = numSectors; i < numAllocated; i++)
+    bitMap->Clear(indirectTables[i / NUM_DIRECT].dataSectors[i % NUM_DIRECT]);
+  for (unsigned i = numTables; i < allocatedTables; i++)
   {
-    unsigned table = DivRoundDown(i, NUM_DIRECT);
-    indirectTables[table].dataSectors[indexInTable++] = bitMap->Find();
-    indexInTable %= NUM_DIRECT;
+    bitMap->Clear(raw.tableSectors[i]);
+    tableLoaded[i] = tableDirty[i] = false;
   }
-
-  raw.numBytes = newSize;
-
+  numAllocated = numSectors;
   return true;
-}
\ No newline at end of file
+}
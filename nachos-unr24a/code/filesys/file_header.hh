@@ -15,6 +15,11 @@
 #include "raw_file_header.hh"
 #include "lib/bitmap.hh"
 
+/// Bounds on how many sectors `FileHeader::Extend` takes past the end of a
+/// growing file, so that it need not be extended again on the next write.
+const unsigned GROWTH_MIN = 8;
+const unsigned GROWTH_MAX = 64;
+
 /// The following class defines the Nachos "file header" (in UNIX terms, the
 /// “i-node”), describing where on disk to find all of the data in the file.
 /// The file header is organized as a simple table of pointers to data
@@ -26,15 +31,19 @@
 /// Without indirect addressing, this limits the maximum file length to just
 /// under 4K bytes.
 ///
-/// There is no constructor; rather the file header can be initialized
-/// by allocating blocks for the file (if it is a new file), or by
-/// reading it from disk.
+/// The file header can be initialized by allocating blocks for the file
+/// (if it is a new file), or by reading it from disk.
+///
+/// Indirection tables are read from disk the first time they are needed,
+/// and only the parts that changed are written back.
 class FileHeader
 {
 public:
+  FileHeader();
+
   /// Initialize a file header, including allocating space on disk for the
-  /// file data.
-  bool Allocate(Bitmap *bitMap, unsigned fileSize);
+  /// file data.  Space is looked for from sector `goal` on.
+  bool Allocate(Bitmap *bitMap, unsigned fileSize, unsigned goal = 0);
 
   /// De-allocate this file's data blocks.
   void Deallocate(Bitmap *bitMap);
@@ -42,9 +51,14 @@ public:
   /// Initialize file header from disk.
   void FetchFrom(unsigned sectorNumber);
 
-  /// Write modifications to file header back to disk.
+  /// Write modifications to file header back to disk.  Only the header
+  /// sector and the tables that changed since the last `FetchFrom` or
+  /// `WriteBack` are written.
   void WriteBack(unsigned sectorNumber);
 
+  /// Make sure the file's tables and data blocks have reached the disk.
+  void Sync();
+
   /// Convert a byte offset into the file to the disk sector containing the
   /// byte.
   unsigned ByteToSector(unsigned offset);
@@ -61,19 +75,39 @@ public:
   /// system at a low level.
   const RawFileHeader *GetRaw() const;
 
-  const IndirectionTable *GetTables() const;
+  /// Get indirection table `i`, reading it first if needed.
+  const IndirectionTable *GetTable(unsigned i);
 
   unsigned GetNumSectors();
   unsigned GetNumTables();
 
-  unsigned GetInitSector();
+  /// Grow the file to `newSize` bytes, taking some sectors beyond that
+  /// unless `preallocate` is false.
+  bool Extend(unsigned newSize, Bitmap *bitMap, bool preallocate = true);
 
-  bool Extend(unsigned newSize, Bitmap *bitMap);
+  /// Would `Extend` to `newSize` bytes need new sectors?
+  bool NeedsSectors(unsigned newSize) const;
 
-  IndirectionTable indirectTables[NUM_INDIRECT];
+  /// Does the file hold sectors past its end?
+  bool HasPreallocated() const;
+
+  /// Give back the sectors taken past the end of the file.
+  bool Trim(Bitmap *bitMap);
 
 private:
   RawFileHeader raw;
+  IndirectionTable indirectTables[NUM_INDIRECT];
+
+  bool rawDirty;                     ///< `raw` changed.
+  bool tableLoaded[NUM_INDIRECT];    ///< Table was read or initialized.
+  bool tableDirty[NUM_INDIRECT];     ///< Table changed.
+
+  /// Data sectors held by the file, counting the ones preallocated past
+  /// its end.  These last are only known in memory.
+  unsigned numAllocated;
+
+  void LoadTable(unsigned i);
+  bool Grow(unsigned target, Bitmap *bitMap);
 };
 
 #endif
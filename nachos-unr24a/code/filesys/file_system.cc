@@ -32,9 +32,9 @@
 /// * files cannot be bigger than about 3KB in size;
 /// * there is no hierarchical directory structure, and only a limited number
 ///   of files can be added to the system;
-/// * there is no attempt to make the system robust to failures (if Nachos
-///   exits in the middle of an operation that modifies the file system, it
-///   may corrupt the disk).
+/// * only the metadata is made robust to failures, by the journal (if
+///   Nachos exits in the middle of writing a file, the end of the data may
+///   be lost).
 ///
 /// Copyright (c) 1992-1993 The Regents of the University of California.
 ///               2016-2021 Docentes de la Universidad Nacional de Rosario.
@@ -52,18 +52,15 @@
 #include "threads/system.hh"
 
 #include "open_file.hh"
-#include "threads/lock.hh"
+#include "threads/rw_lock.hh"
 #include "synchFile.hh"
 
 #include "synchDirectory.hh"
 #include "synchBitmap.hh"
+#include "disk_layout.hh"
+#include "fsck.hh"
 
 // #include "threads/system.hh"
-/// Sectors containing the file headers for the bitmap of free sectors, and
-/// the directory of files.  These file headers are placed in well-known
-/// sectors, so that they can be located on boot-up.
-static const unsigned FREE_MAP_SECTOR = 0;
-static const unsigned DIRECTORY_SECTOR = 1;
 
 /// Initialize the file system.  If `format == true`, the disk has nothing on
 /// it, and we need to initialize the disk to contain an empty directory, and
@@ -79,7 +76,7 @@ FileSystem::FileSystem(bool format)
 {
   DEBUG('f', "Initializing the file system.\n");
   directoryTable = new DirectoryTable();
-  freeMapLock = new Lock("Freemap lock");
+  freeMapLock = new RWLock("Freemap lock");
   // directoryLock = new Lock("Directory lock");
 
   SynchFile *synchFreeMap = nullptr;
@@ -88,9 +85,40 @@ FileSystem::FileSystem(bool format)
   SynchFile *synchDirectory = nullptr;
   FileHeader *dirH = new FileHeader;
 
+  SuperBlock super;
+  char buffer[SECTOR_SIZE];
+  if (format)
+  {
+    // The geometry is whatever the disk was created with.
+    memset(buffer, 0, SECTOR_SIZE);
+    super.magic = SUPER_MAGIC;
+    super.sectorSize = SECTOR_SIZE;
+    super.sectorsPerTrack = synchDisk->GetSectorsPerTrack();
+    super.numTracks = synchDisk->GetNumSectors() / super.sectorsPerTrack;
+    super.state = SUPER_CLEAN;
+    memcpy(buffer, &super, sizeof super);
+    synchDisk->WriteSector(SUPER_SECTOR, buffer);
+  }
+  else
+  {
+    synchDisk->ReadSector(SUPER_SECTOR, buffer);
+    memcpy(&super, buffer, sizeof super);
+    if (super.magic != SUPER_MAGIC || super.sectorSize != SECTOR_SIZE)
+    {
+      fprintf(stderr, "DISK is not formatted, or was formatted for %u-byte sectors.\n",
+              super.magic == SUPER_MAGIC ? super.sectorSize : 0);
+      ASSERT(false);
+    }
+    synchDisk->SetGeometry(super.sectorsPerTrack, super.numTracks);
+  }
+  unsigned numSectors = synchDisk->GetNumSectors();
+  ASSERT(numSectors >= MIN_NUM_SECTORS && numSectors <= MAX_NUM_SECTORS);
+  DEBUG('f', "Disk of %u tracks of %u sectors.\n",
+        super.numTracks, super.sectorsPerTrack);
+
+  freeMap = new SynchBitmap(numSectors, freeMapLock);
   if (format)
   {
-    SynchBitmap *freeMap = new SynchBitmap(NUM_SECTORS, freeMapLock);
 
     // SynchDirectory *dir = new SynchDirectory(NUM_DIR_ENTRIES, directoryLock);
 
@@ -100,12 +128,16 @@ FileSystem::FileSystem(bool format)
     // (make sure no one else grabs these!)
     freeMap->Request();
 
+    freeMap->Mark(SUPER_SECTOR);
     freeMap->Mark(FREE_MAP_SECTOR);
     freeMap->Mark(DIRECTORY_SECTOR);
+    for (unsigned i = 0; i < JOURNAL_SECTORS; i++)
+      freeMap->Mark(JOURNAL_SECTOR + i);
+    journal->Format();
 
     // Second, allocate space for the data blocks containing the contents
     // of the directory and bitmap files.  There better be enough space!
-    ASSERT(mapH->Allocate(freeMap->GetBitmap(), FREE_MAP_FILE_SIZE));
+    ASSERT(mapH->Allocate(freeMap->GetBitmap(), FreeMapSize(numSectors)));
     ASSERT(dirH->Allocate(freeMap->GetBitmap(), DIRECTORY_FILE_SIZE));
     freeMap->Flush();
 
@@ -150,8 +182,6 @@ FileSystem::FileSystem(bool format)
     {
       freeMap->Print();
       dInfo->synchDir->Print();
-
-      delete freeMap;
       // delete dInfo->synchDir;
     }
   }
@@ -161,30 +191,33 @@ FileSystem::FileSystem(bool format)
     // representing the bitmap and directory; these are left open while
     // Nachos is running.
     DEBUG('f', "Opening the file system w/o format.\n");
+    journal->Recover();
     mapH->FetchFrom(FREE_MAP_SECTOR);
     freeMapFile = new OpenFile(mapH, synchFreeMap, 0);
+    freeMap->Load(freeMapFile);
     dirH->FetchFrom(DIRECTORY_SECTOR);
     rootDirectory = new OpenFile(dirH, synchDirectory, 1);
     directoryTable->AddDirectory(nullptr, rootDirectory, DIRECTORY_SECTOR, DIRECTORY_SECTOR);
   }
 
+  // Nachos may have stopped while some file still had sectors taken
+  // ahead of its writes.
+  clean = super.state == SUPER_CLEAN;
+  if (!clean && Reclaim())
+    SetClean(true);
+
   openFiles = new OpenFilesTable();
-  openFiles->AddFile(nullptr, mapH, synchFreeMap);
-  openFiles->AddFile(nullptr, dirH, synchDirectory);
+  openFiles->AddFile(nullptr, mapH, synchFreeMap, FREE_MAP_SECTOR);
+  openFiles->AddFile(nullptr, dirH, synchDirectory, DIRECTORY_SECTOR);
 }
 
 FileSystem::~FileSystem()
 {
+  delete freeMap;
   delete freeMapFile;
   delete rootDirectory;
 }
 
-OpenFile *getActualDirectory()
-{
-  OpenFile *directoryFile = currentThread->GetCurrentDirectory();
-  return new OpenFile(directoryFile->GetHdr(), directoryFile->GetSynch(), directoryFile->GetId());
-}
-
 /// Create a file in the Nachos file system (similar to UNIX `create`).
 /// Since we cannot increase the size of files dynamically, we have to give
 /// `Create` the initial size of the file.
@@ -215,54 +248,28 @@ bool FileSystem::CreateFileDirectory(const char *name, unsigned initialSize, boo
   ASSERT(name != nullptr);
   ASSERT(initialSize < MAX_FILE_SIZE);
 
-  DEBUG('f', "Creating file %s, size %u\n", name, initialSize);
-  char path[strlen(name) + 1];
-  const char *fName = sepPath(name, path);
-  // the file is in this directory
-  DEBUG('f', "Creating file %s, path %s, isDir: %d\n", fName, path, isDir);
-  if (strcmp(path, "") == 0)
-  {
-    return CreateAtomic(fName, initialSize, isDir);
-  }
-  else
-  {
-    OpenFile *actual = getActualDirectory();
-    if (!changeDirectory(path))
-    {
-      // delete actual;
-      return false;
-    }
-    DEBUG('f', "Pre second if\n");
-    if (CreateAtomic(fName, initialSize, isDir))
-    {
-      currentThread->SetCurrentDirectory(actual);
-      return true;
-    }
-  }
-  return false;
+  DEBUG('f', "Creating file %s, size %u, isDir: %d\n", name, initialSize, isDir);
+  DirectoryInfo *dInfo;
+  char leaf[FILE_NAME_MAX_LEN + 1];
+  int sector;
+  if (!Namei(name, &dInfo, leaf, &sector) || leaf[0] == '\0')
+    return false;
+  return CreateAtomic(dInfo, leaf, initialSize, isDir);
 }
 
-bool FileSystem::CreateAtomic(const char *name, unsigned initialSize, bool isDir)
+bool FileSystem::CreateAtomic(DirectoryInfo *dInfo, const char *name, unsigned initialSize, bool isDir)
 {
+  ASSERT(dInfo != nullptr);
   ASSERT(name != nullptr);
 
-  OpenFile *actualDirectory = currentThread->GetCurrentDirectory();
-  DirectoryInfo *dInfo = directoryTable->GetDirectoryInfo2(actualDirectory);
-  if (dInfo == nullptr)
-  {
-    FileInfo *aux = openFiles->GetFileInfo(actualDirectory->GetId());
-    DEBUG('f', "'CreateAtomic'dInfo is null, fileId: %d, name: \n", actualDirectory->GetId(), aux->name);
-    return false;
-  }
-  else
-  {
-    DEBUG('f', "'CreateAtomic' dInfo size: %d, file: %p , dir: %p\n", dInfo->size, dInfo->file, dInfo->synchDir);
-  }
+  DEBUG('f', "'CreateAtomic' dInfo size: %d, file: %p , dir: %p\n", dInfo->size, dInfo->file, dInfo->synchDir);
+  OpenFile *actualDirectory = dInfo->file;
   SynchDirectory *dir = dInfo->synchDir;
   DEBUG('f', "Thread: %s (%p) 'Creating atomic', dir: %p\n", currentThread->GetName(), currentThread, dir);
   if (dir == nullptr)
     DEBUG('f', "dir is null\n");
 
+  journal->Begin();
   dir->FetchFrom(actualDirectory);
 
   DEBUG('f', "'Creating atomic' fetched %s, size %u\n", name, initialSize);
@@ -273,8 +280,7 @@ bool FileSystem::CreateAtomic(const char *name, unsigned initialSize, bool isDir
   }
   else
   {
-    SynchBitmap *freeMap = new SynchBitmap(NUM_SECTORS, freeMapLock);
-    freeMap->FetchFrom(freeMapFile);
+    freeMap->Request();
     int sector = freeMap->Find();
     // Find a sector to hold the file header.
     if (sector == -1)
@@ -291,7 +297,7 @@ bool FileSystem::CreateAtomic(const char *name, unsigned initialSize, bool isDir
       // dir->Add(name, sector, isDir);
       DEBUG('f', "Space in directory.\n");
       FileHeader *h = new FileHeader;
-      success = h->Allocate(freeMap->GetBitmap(), initialSize);
+      success = h->Allocate(freeMap->GetBitmap(), initialSize, sector + 1);
       DEBUG('f', "Allocate.\n");
       // Fails if no space on disk for data.
       if (success)
@@ -299,32 +305,41 @@ bool FileSystem::CreateAtomic(const char *name, unsigned initialSize, bool isDir
         // Everything worked, flush all changes back to disk.
         DEBUG('f', "Fheader write.\n");
         h->WriteBack(sector);
+        // The free map goes first: writing the directory may extend it,
+        // and that needs the free map too.
+        DEBUG('f', "freeMap write.\n");
+        freeMap->WriteBack(freeMapFile);
 
         DEBUG('f', "Dir write.\n");
         if (isDir)
         {
           SynchFile *newFile = new SynchFile();
-          int fid = openFiles->AddFile(name, h, newFile);
-          DEBUG('f', "Directory fileId: %d, name: %s\n", fid, openFiles->GetFileInfo(actualDirectory->GetId())->name);
+          int fid = openFiles->AddFile(name, h, newFile, sector);
+          DEBUG('f', "Directory fileId: %d, name: %s\n", fid, name);
           OpenFile *newDir = new OpenFile(h, newFile, fid);
-          unsigned did = directoryTable->AddDirectory(name, newDir, sector, actualDirectory->GetHdr()->GetInitSector());
+          unsigned did = directoryTable->AddDirectory(name, newDir, sector, dir->GetSector());
           SynchDirectory *newDirSynch = directoryTable->GetDirectoryInfo(did)->synchDir;
           newDirSynch->Request();
           newDirSynch->WriteBack(newDir);
           DEBUG('f', "Directory id: %d, name: %s\n", did, name);
-          DEBUG('f', "currentSector: %u, parentSector: %u\n", sector, actualDirectory->GetHdr()->GetInitSector());
+          DEBUG('f', "currentSector: %u, parentSector: %u\n", sector, dir->GetSector());
         }
         DEBUG('f', "actualDir write.\n");
         dir->WriteBack(actualDirectory);
-        DEBUG('f', "freeMap write.\n");
-        freeMap->WriteBack(freeMapFile);
       }
       // delete h;
     }
-    delete freeMap;
+    if (!success)
+    {
+      // `Allocate` takes nothing when it fails; give the header back.
+      if (sector != -1)
+        freeMap->Clear(sector);
+      freeMap->Flush();
+    }
   }
   if (!success)
     dir->Flush();
+  journal->End();
   // delete dir;
   return success;
 }
@@ -342,80 +357,50 @@ bool FileSystem::CreateDirectory(const char *name)
 ///
 /// To open a file:
 /// 1. Find the location of the file's header, using the directory.
-/// 2. Bring the header into memory.
+/// 2. Bring the header into memory, unless it is still there from an
+///    earlier open.
 ///
 /// * `name` is the text name of the file to be opened.
 OpenFile *
 FileSystem::Open(const char *name)
 {
   ASSERT(name != nullptr);
-  int fid;
-  OpenFile *openFile = NULL;
-  if ((fid = openFiles->Find(name)) == -1)
+  DirectoryInfo *dInfo;
+  char leaf[FILE_NAME_MAX_LEN + 1];
+  int sector;
+  if (!Namei(name, &dInfo, leaf, &sector) || leaf[0] == '\0' || sector < 0)
   {
-
-    char path[strlen(name) + 1];
-    const char *fName = sepPath(name, path);
-    if (strcmp(path, "") == 0)
-    {
-      OpenFile *actualDirectory = currentThread->GetCurrentDirectory();
-      DirectoryInfo *dInfo = directoryTable->GetDirectoryInfo2(actualDirectory);
-      if (dInfo == nullptr)
-        DEBUG('f', "'open' dInfo is null, id: %d\n", actualDirectory->GetId());
-      else
-      {
-        DEBUG('f', "'Open' dInfo size: %d, file: %p , dir: %p\n", dInfo->size, dInfo->file, dInfo->synchDir);
-      }
-
-      SynchDirectory *dir = dInfo->synchDir;
-
-      DEBUG('f', "Opening file %s\n", name);
-      dir->FetchFrom(dInfo->file);
-      int sector = dir->Find(name);
-      if (sector >= 0)
-      {
-        FileHeader *hdr = new FileHeader;
-        hdr->FetchFrom(sector);
-
-        SynchFile *synchFile = new SynchFile;
-        DEBUG('f', "File %s opened\n", name);
-        fid = openFiles->AddFile(name, hdr, synchFile);
-        DEBUG('f', "File %s opened with fid %d\n", name, fid);
-        if (fid != -1)
-          openFile = new OpenFile(hdr, synchFile, fid); // `name` was found in directory.
-        else
-        {
-          delete hdr;
-          delete synchFile;
-        }
-      }
-      DEBUG('f', "File %s in sector %d\n", name, sector);
-      dir->Flush();
-    }
-    else
-    {
-      OpenFile *actual = getActualDirectory();
-      if (!changeDirectory(path))
-        return NULL;
-
-      DEBUG('f', "Pre second if\n");
-      if (OpenFile *_file = Open(fName))
-      {
-        currentThread->SetCurrentDirectory(actual);
-        return _file;
-      }
-    }
+    DEBUG('f', "File %s not found\n", name);
+    return nullptr;
   }
-  // If the file is already open, return the file.
-  else
+
+  int fid;
+  OpenFile *openFile = nullptr;
+  if ((fid = openFiles->Acquire(sector)) != -1)
   {
     FileInfo *finfo = openFiles->GetFileInfo(fid);
     if (finfo->available)
     {
-      finfo->nThreads++;
       DEBUG('f', "File %s opened with fid %d\n", name, fid);
       openFile = new OpenFile(finfo->hdr, finfo->synchFile, fid);
     }
+    else
+      finfo->nThreads--; // Removed, but still open elsewhere.
+  }
+  else
+  {
+    FileHeader *hdr = new FileHeader;
+    hdr->FetchFrom(sector);
+
+    // Another thread may have brought the header in while this one
+    // waited for the disk.
+    if ((fid = openFiles->Acquire(sector)) != -1)
+      delete hdr;
+    else
+      fid = openFiles->AddFile(leaf, hdr, new SynchFile, sector);
+    FileInfo *finfo = openFiles->GetFileInfo(fid);
+    DEBUG('f', "File %s opened with fid %d\n", name, fid);
+    openFile = new OpenFile(finfo->hdr, finfo->synchFile, fid); // `name` was found in directory.
   }
   return openFile;
 }
@@ -426,45 +411,64 @@ void FileSystem::Close(int fid)
   finfo->nThreads--;
   if (finfo->nThreads == 0)
   {
+    Trim(finfo);
     if (!finfo->available)
-      this->Delete(finfo->name);
-    delete finfo->hdr;
-    // delete finfo->synchFile;
-    openFiles->RemoveFile(fid);
+    {
+      int did = directoryTable->FindBySector(finfo->dirSector);
+      this->Delete(directoryTable->GetDirectoryInfo(did), finfo->name);
+      openFiles->RemoveFile(fid);
+    }
+    else
+      openFiles->Release(fid);
   }
 }
 
-bool FileSystem::Delete(const char *name)
+/// Sectors preallocated by `Extend` for `finfo` and not written to go back
+/// to the free map.
+void FileSystem::Trim(FileInfo *finfo)
 {
+  ASSERT(finfo != nullptr);
+
+  if (!finfo->hdr->HasPreallocated())
+    return;
+  journal->Begin();
+  freeMap->Request();
+  finfo->hdr->Trim(freeMap->GetBitmap());
+  finfo->hdr->WriteBack(finfo->sector);
+  freeMap->WriteBack(freeMapFile);
+  journal->End();
+}
+
+bool FileSystem::Delete(DirectoryInfo *dInfo, const char *name)
+{
+  ASSERT(dInfo != nullptr);
   ASSERT(name != nullptr);
-  OpenFile *actualDirectory = currentThread->GetCurrentDirectory();
-  DirectoryInfo *dInfo = directoryTable->GetDirectoryInfo2(actualDirectory);
   SynchDirectory *dir = dInfo->synchDir;
 
   DEBUG('f', "Opening file %s\n", name);
+  journal->Begin();
   dir->FetchFrom(dInfo->file);
   int sector = dir->Find(name);
   if (sector == -1)
   {
     dir->Flush();
+    journal->End();
     // delete dir;
     return false; // file not found
   }
   FileHeader *fileH = new FileHeader;
   fileH->FetchFrom(sector);
 
-  SynchBitmap *freeMap = new SynchBitmap(NUM_SECTORS, freeMapLock);
-  freeMap->FetchFrom(freeMapFile);
-
+  freeMap->Request();
   fileH->Deallocate(freeMap->GetBitmap()); // Remove data blocks.
   freeMap->Clear(sector);                  // Remove header block.
   dir->Remove(name);
 
   freeMap->WriteBack(freeMapFile); // Flush to disk.
   dir->WriteBack(dInfo->file);     // Flush to disk.
+  journal->End();
   delete fileH;
   // delete dir;
-  delete freeMap;
   return true;
 }
 
@@ -483,60 +487,130 @@ bool FileSystem::Delete(const char *name)
 bool FileSystem::Remove(const char *name)
 {
   ASSERT(name != nullptr);
+  DirectoryInfo *dInfo;
+  char leaf[FILE_NAME_MAX_LEN + 1];
+  int sector;
+  if (!Namei(name, &dInfo, leaf, &sector) || leaf[0] == '\0' || sector == -1)
+    return false;
+
   int fid;
-  // If someone wants to remove one file, but it was being used by another thread, we just mark it as unavailable.
-  if ((fid = openFiles->Find(name)) != -1)
+  if ((fid = openFiles->FindBySector(sector)) != -1)
   {
     FileInfo *finfo = openFiles->GetFileInfo(fid);
-    finfo->available = false;
+    // If someone wants to remove one file, but it was being used by another thread, we just mark it as unavailable.
+    if (finfo->nThreads > 0)
+    {
+      finfo->available = false;
+      finfo->dirSector = dInfo->synchDir->GetSector();
+      return true;
+    }
+    openFiles->RemoveFile(fid); // Only kept in memory after its last close.
   }
-  else
-    return this->Delete(name);
-  return true;
+  return this->Delete(dInfo, leaf);
 }
 
 bool FileSystem::Extend(unsigned newSize, unsigned id)
 {
 
   ASSERT(newSize < MAX_FILE_SIZE);
-  FileInfo *finfo;
-  ASSERT((finfo = openFiles->GetFileInfo(id)) != nullptr);
-
-  OpenFile *actualDirectory = currentThread->GetCurrentDirectory();
-  DirectoryInfo *dInfo = directoryTable->GetDirectoryInfo2(actualDirectory);
-  SynchDirectory *dir = dInfo->synchDir;
-
-  dir->FetchFrom(dInfo->file);
+  FileInfo *finfo = openFiles->GetFileInfo(id);
+  ASSERT(finfo != nullptr);
+  FileHeader *h = finfo->hdr;
 
-  int sector = dir->Find(finfo->name);
-  if (sector == -1)
+  // Usually an earlier extension already took the sectors, and only the
+  // length in the header changes.  That is left out of the journal: losing
+  // it in a crash loses the end of the file, but nothing else.
+  if (!h->NeedsSectors(newSize))
   {
-    DEBUG('f', "File not found, name: %s.\n", finfo->name);
-    // delete dir;
-    return false;
+    h->Extend(newSize, nullptr);
+    h->WriteBack(finfo->sector);
+    return true;
   }
 
-  FileHeader *h = finfo->hdr;
-
-  SynchBitmap *freeMap = new SynchBitmap(NUM_SECTORS, freeMapLock);
-  freeMap->FetchFrom(freeMapFile);
-
-  bool success = h->Extend(newSize, freeMap->GetBitmap());
+  // Directories stay open until Nachos exits, so nothing would trim them.
+  bool preallocate = directoryTable->FindBySector(finfo->sector) == -1;
+  // If Nachos stops before the file is closed, the superblock tells the
+  // next mount to look for what it took.
+  if (preallocate && clean)
+    SetClean(false);
+  journal->Begin();
+  freeMap->Request();
+  bool success = h->Extend(newSize, freeMap->GetBitmap(), preallocate);
   if (success)
   {
-    h->WriteBack(sector);
+    h->WriteBack(finfo->sector);
     freeMap->WriteBack(freeMapFile);
   }
   else
-  {
-    h->FetchFrom(sector);
     freeMap->Flush();
+  journal->End();
+  return success;
+}
+
+/// Write the cached data blocks of file `id`, its header and the free map
+/// to disk.  Return false if the file is not open.
+bool FileSystem::Fsync(unsigned id)
+{
+  FileInfo *finfo = openFiles->GetFileInfo(id);
+  if (finfo == nullptr)
+    return false;
+
+  finfo->hdr->Sync();
+  blockCache->SyncSector(finfo->sector);
+  freeMapFile->GetHdr()->Sync();
+  return true;
+}
+
+/// Give back what `Extend` took ahead for the files still open, and write
+/// everything cached to disk, emptying the journal.  Then the disk can be
+/// marked clean, so that the next mount does not look for lost sectors.
+void FileSystem::Shutdown()
+{
+  for (unsigned id = 0; id < openFiles->Size(); id++)
+  {
+    FileInfo *finfo = openFiles->GetFileInfo(id);
+    if (finfo != nullptr)
+      Trim(finfo);
   }
-  dir->Flush();
+  blockCache->Sync();
+  journal->Checkpoint();
+  if (!clean)
+    SetClean(true);
+}
 
-  delete freeMap;
-  // delete dir;
-  return success;
+/// The superblock is written straight to the disk, and not through the
+/// cache: when marking it not clean, it must be there before the free map
+/// taking the sectors is.
+void FileSystem::SetClean(bool value)
+{
+  SuperBlock super;
+  char buffer[SECTOR_SIZE];
+  synchDisk->ReadSector(SUPER_SECTOR, buffer);
+  memcpy(&super, buffer, sizeof super);
+  super.state = value ? SUPER_CLEAN : 0;
+  memcpy(buffer, &super, sizeof super);
+  synchDisk->WriteSector(SUPER_SECTOR, buffer);
+  clean = value;
+  DEBUG('f', "Disk marked %s.\n", value ? "clean" : "in use");
+}
+
+/// Look `name` up in the directory described by `dInfo`, going through the
+/// name cache.  Return the sector of its header, or -1 if it is not there.
+int FileSystem::Lookup(DirectoryInfo *dInfo, const char *name)
+{
+  SynchDirectory *dir = dInfo->synchDir;
+  unsigned dirSector = dir->GetSector();
+  int sector;
+  if (nameCache->Lookup(dirSector, name, &sector))
+    return sector;
+
+  // Entered while the directory is locked, so that no update can come in
+  // between.
+  dir->StartLookup(dInfo->file);
+  sector = dir->Find(name);
+  nameCache->Enter(dirSector, name, sector);
+  dir->DoneLookup();
+  return sector;
 }
 
 /// List all the files in the file system directory.
@@ -545,225 +619,96 @@ void FileSystem::List()
   DEBUG('f', "Listing directory 1.\n");
   OpenFile *actualDirectory = currentThread->GetCurrentDirectory();
   DEBUG('f', "Listing directory 2. (%d)\n", actualDirectory->GetId());
-  DirectoryInfo *dInfo = directoryTable->GetDirectoryInfo2(actualDirectory);
+  DirectoryInfo *dInfo = DirectoryOf(actualDirectory);
   DEBUG('f', "Listing directory 3.\n");
   ASSERT(dInfo != nullptr);
   SynchDirectory *dir = dInfo->synchDir;
   DEBUG('f', "Listing directory %s.\n", dInfo->name);
-  dir->FetchFrom(dInfo->file);
+  dir->StartLookup(dInfo->file);
   dir->List();
-  dir->Flush();
+  dir->DoneLookup();
 
   // delete dir;
 }
 
-static bool
-AddToShadowBitmap(unsigned sector, Bitmap *map)
-{
-  ASSERT(map != nullptr);
-
-  if (map->Test(sector))
-  {
-    DEBUG('f', "Sector %u was already marked.\n", sector);
-    return false;
-  }
-  map->Mark(sector);
-  DEBUG('f', "Marked sector %u.\n", sector);
-  return true;
-}
-
-static bool
-CheckForError(bool value, const char *message)
+static void
+ReportProblem(const char *message)
 {
-  if (!value)
-  {
-    DEBUG('f', "Error: %s\n", message);
-  }
-  return !value;
+  DEBUG('f', "Error: %s\n", message);
 }
 
-static bool
-CheckSector(unsigned sector, Bitmap *shadowMap)
-{
-  if (CheckForError(sector < NUM_SECTORS,
-                    "sector number too big.  Skipping bitmap check."))
-  {
-    return true;
-  }
-  return CheckForError(AddToShadowBitmap(sector, shadowMap),
-                       "sector number already used.");
-}
-
-static bool
-CheckFileHeader(FileHeader *h, unsigned num, Bitmap *shadowMap)
+/// Check the file system as it would be found if Nachos stopped now: what
+/// is cached is written first, and the journal emptied.  Then the whole
+/// disk is read in one sweep, sector after sector, and checked in memory by
+/// `Fsck`.  Nothing is repaired here; `bin/fsck` does that on a `DISK` file.
+bool FileSystem::Check()
 {
-  const RawFileHeader *rh = h->GetRaw();
-  ASSERT(rh != nullptr);
-
-  bool error = false;
+  DEBUG('f', "Performing filesystem check\n");
 
-  DEBUG('f', "Checking file header %u.  File size: %u bytes, number of sectors: %u.\n",
-        num, rh->numBytes, h->GetNumSectors());
-  error |= CheckForError(h->GetNumSectors() >= DivRoundUp(rh->numBytes,
-                                                          SECTOR_SIZE),
-                         "sector count not compatible with file size.");
-  error |= CheckForError(h->GetNumSectors() < NUM_DIRECT,
-                         "too many blocks.");
+  blockCache->Sync();
+  journal->Checkpoint();
+  unsigned numSectors = synchDisk->GetNumSectors();
+  char *image = new char[numSectors * SECTOR_SIZE];
+  synchDisk->ReadSectors(0, numSectors, image);
 
-  unsigned numSectors = h->GetNumSectors();
-  unsigned numTables = h->GetNumTables();
+  Fsck *fsck = new Fsck(image, numSectors, ReportProblem);
+  bool ok = fsck->Check();
+  delete fsck;
+  delete[] image;
 
-  for (unsigned i = 0; i < numTables; i++)
-  {
-    unsigned size = numSectors < NUM_DIRECT ? numSectors : NUM_DIRECT;
-    for (unsigned j = 0; j < size; j++)
-    {
-      unsigned s = h->indirectTables[i].dataSectors[j];
-      DEBUG('f', "Checking sector %u. indirectTables[%u].dataSectors[%u]: %u.", s, j, i);
-      error |= CheckSector(s, shadowMap);
-    }
-    numSectors -= NUM_DIRECT;
-  }
-
-  // for (unsigned i = 0; i < h->GetNumSectors(); i++)
-  // {
-  //   unsigned s = rh->tableSectors[i];
-  //   error |= CheckSector(s, shadowMap);
-  // }
-  return error;
+  DEBUG('f', ok ? "Filesystem check succeeded.\n"
+                : "Filesystem check failed.\n");
+  return ok;
 }
 
-static bool
-CheckBitmaps(const Bitmap *freeMap, const Bitmap *shadowMap)
-{
-  bool error = false;
-  for (unsigned i = 0; i < NUM_SECTORS; i++)
-  {
-    DEBUG('f', "Checking sector %u. Original: %u, shadow: %u.\n",
-          i, freeMap->Test(i), shadowMap->Test(i));
-    error |= CheckForError(freeMap->Test(i) == shadowMap->Test(i),
-                           "inconsistent bitmap.");
-  }
-  return error;
-}
-
-static bool
-CheckDirectory(const RawDirectory *rd, Bitmap *shadowMap)
+/// Clear the sectors that are taken in the free map, but that no file uses.
+/// `Extend` takes sectors ahead of the writes to a file, and they are only
+/// given back when it is closed, or by `Shutdown`; if Nachos stopped in
+/// some other way, they would stay taken for good, since the file headers
+/// only tell the sectors within the length of the file.
+///
+/// The tree is read the way `Check` does.  If something in it looks wrong,
+/// nothing is freed, since the sectors of a broken file would be counted as
+/// unused; that is left to `bin/fsck`.  Returns whether the free map could
+/// be checked.
+bool FileSystem::Reclaim()
 {
-  ASSERT(rd != nullptr);
-  ASSERT(shadowMap != nullptr);
-
-  bool error = false;
-  unsigned nameCount = 0;
-  const char *knownNames[NUM_DIR_ENTRIES];
-  // Comenzamos en 2 pues los primeros dos son . y .. y siempre estaran presentes
-  for (unsigned i = 2; i < NUM_DIR_ENTRIES; i++)
+  DEBUG('f', "Looking for sectors taken ahead of the writes.\n");
+
+  blockCache->Sync();
+  unsigned numSectors = synchDisk->GetNumSectors();
+  char *image = new char[numSectors * SECTOR_SIZE];
+  synchDisk->ReadSectors(0, numSectors, image);
+
+  Fsck *fsck = new Fsck(image, numSectors, ReportProblem);
+  unsigned char *counts = new unsigned char[numSectors]();
+  bool ok = fsck->ScanTree() == 0 &&
+            fsck->CheckFiles(0, fsck->NumFiles(), counts) == 0;
+  if (ok)
   {
-    DEBUG('f', "Checking direntry: %u.\n", i);
-    const DirectoryEntry *e = &rd->table[i];
-
-    if (e->inUse)
-    {
-      if (strlen(e->name) > FILE_NAME_MAX_LEN)
-      {
-        DEBUG('f', "Filename too long.\n");
-        error = true;
-      }
-
-      // Check for repeated filenames.
-      DEBUG('f', "Checking for repeated names.  Name count: %u.\n",
-            nameCount);
-      bool repeated = false;
-      for (unsigned j = 0; j < nameCount; j++)
-      {
-        DEBUG('f', "Comparing \"%s\" and \"%s\".\n",
-              knownNames[j], e->name);
-        if (strcmp(knownNames[j], e->name) == 0)
-        {
-          DEBUG('f', "Repeated filename.\n");
-          repeated = true;
-          error = true;
-        }
-      }
-      if (!repeated)
+    fsck->AddReferences(counts);
+    unsigned freed = 0;
+    journal->Begin();
+    freeMap->Request();
+    for (unsigned s = 0; s < numSectors; s++)
+      if (freeMap->Test(s) && !fsck->IsUsed(s))
       {
-        knownNames[nameCount] = e->name;
-        DEBUG('f', "Added \"%s\" at %u.\n", e->name, nameCount);
-        nameCount++;
+        freeMap->Clear(s);
+        freed++;
       }
-
-      // Check sector.
-      error |= CheckSector(e->sector, shadowMap);
-
-      // Check file header.
-      FileHeader *h = new FileHeader;
-      const RawFileHeader *rh = h->GetRaw();
-      h->FetchFrom(e->sector);
-      error |= CheckFileHeader(h, e->sector, shadowMap);
-      delete h;
-    }
+    if (freed > 0)
+      freeMap->WriteBack(freeMapFile);
+    else
+      freeMap->Flush();
+    journal->End();
+    DEBUG('f', "%u sectors given back to the free map.\n", freed);
   }
-  return error;
+  delete[] counts;
+  delete fsck;
+  delete[] image;
+  return ok;
 }
 
-bool FileSystem::Check()
-{
-  DEBUG('f', "Performing filesystem check\n");
-  bool error = false;
-
-  Bitmap *shadowMap = new Bitmap(NUM_SECTORS);
-  shadowMap->Mark(FREE_MAP_SECTOR);
-  shadowMap->Mark(DIRECTORY_SECTOR);
-  // Este sector correspondera a la 1era direccion de la tabla de indirecciones
-  shadowMap->Mark(DIRECTORY_SECTOR + 1);
-
-  DEBUG('f', "Checking bitmap's file header.\n");
-
-  FileHeader *bitH = new FileHeader;
-  const RawFileHeader *bitRH = bitH->GetRaw();
-  bitH->FetchFrom(FREE_MAP_SECTOR);
-  DEBUG('f', "  File size: %u bytes, expected %u bytes.\n"
-             "  Number of sectors: %u, expected %u.\n",
-        bitRH->numBytes, FREE_MAP_FILE_SIZE,
-        bitH->GetNumSectors(), FREE_MAP_FILE_SIZE / SECTOR_SIZE);
-  error |= CheckForError(bitRH->numBytes == FREE_MAP_FILE_SIZE,
-                         "bad bitmap header: wrong file size.");
-  error |= CheckForError(bitH->GetNumSectors() == FREE_MAP_FILE_SIZE / SECTOR_SIZE,
-                         "bad bitmap header: wrong number of sectors.");
-  error |= CheckFileHeader(bitH, FREE_MAP_SECTOR, shadowMap);
-  delete bitH;
-
-  DEBUG('f', "Checking directory.\n");
-
-  FileHeader *dirH = new FileHeader;
-  // const RawFileHeader *dirRH = dirH->GetRaw();
-  dirH->FetchFrom(DIRECTORY_SECTOR);
-  error |= CheckFileHeader(dirH, DIRECTORY_SECTOR, shadowMap);
-  delete dirH;
-
-  Bitmap *freeMap = new Bitmap(NUM_SECTORS);
-  freeMap->FetchFrom(freeMapFile);
-  Directory *dir = new Directory(NUM_DIR_ENTRIES, DIRECTORY_SECTOR, DIRECTORY_SECTOR);
-  // Este sector correspondera a la 1era direccion de la tabla de indirecciones del directorio
-  shadowMap->Mark(DIRECTORY_SECTOR + 3);
-  const RawDirectory *rdir = dir->GetRaw();
-  dir->FetchFrom(rootDirectory);
-  error |= CheckDirectory(rdir, shadowMap);
-  delete dir;
-
-  // The two bitmaps should match.
-  DEBUG('f', "Checking bitmap consistency.\n");
-  error |= CheckBitmaps(freeMap, shadowMap);
-  delete shadowMap;
-  delete freeMap;
-
-  DEBUG('f', error ? "Filesystem check failed.\n"
-                   : "Filesystem check succeeded.\n");
-
-  return !error;
-}
-// bool FileSystem::Check() { return false; }
-
 /// Print everything about the file system:
 /// * the contents of the bitmap;
 /// * the contents of the directory;
@@ -774,9 +719,8 @@ void FileSystem::Print()
 {
   FileHeader *bitH = new FileHeader;
   FileHeader *dirH = new FileHeader;
-  Bitmap *freeMap = new Bitmap(NUM_SECTORS);
   OpenFile *actualDirectory = currentThread->GetCurrentDirectory();
-  DirectoryInfo *dInfo = directoryTable->GetDirectoryInfo2(actualDirectory);
+  DirectoryInfo *dInfo = DirectoryOf(actualDirectory);
   SynchDirectory *dir = dInfo->synchDir;
 
   printf("--------------------------------\n");
@@ -788,102 +732,136 @@ void FileSystem::Print()
   dirH->Print("Directory");
 
   printf("--------------------------------\n");
-  freeMap->FetchFrom(freeMapFile);
+  freeMap->StartRead();
   freeMap->Print();
+  freeMap->DoneRead();
 
   printf("--------------------------------\n");
-  dir->FetchFrom(dInfo->file);
+  dir->StartLookup(dInfo->file);
   dir->Print();
+  dir->DoneLookup();
   printf("--------------------------------\n");
 
   delete bitH;
   delete dirH;
-  delete freeMap;
   // delete dir;
 }
 
-OpenFile *FileSystem::OpenDir(const char *name)
+/// Return the entry of the table of directories for `file`, an open
+/// directory, found by the sector of its header.
+DirectoryInfo *FileSystem::DirectoryOf(OpenFile *file)
 {
-  ASSERT(name);
-
-  OpenFile *actualDirectory = currentThread->GetCurrentDirectory();
-  DirectoryInfo *dInfo = directoryTable->GetDirectoryInfo2(actualDirectory);
-  SynchDirectory *dir = dInfo->synchDir;
+  FileInfo *finfo = openFiles->GetFileInfo(file->GetId());
+  ASSERT(finfo != nullptr);
+  int did = directoryTable->FindBySector(finfo->sector);
+  return did == -1 ? nullptr : directoryTable->GetDirectoryInfo(did);
+}
 
-  dir->FetchFrom(actualDirectory);
-  int sector = dir->Find(name);
-  dir->Flush();
-  DEBUG('f', "Opening directory %s in sector %d, dir: %s\n", name, sector, dInfo->name);
+/// Return the directory called `name` inside `dir`, bringing it into the
+/// table of directories if needed.  Return null if there is no such
+/// directory.
+DirectoryInfo *FileSystem::Step(DirectoryInfo *dir, const char *name)
+{
+  int sector = Lookup(dir, name);
   if (sector < 0)
-    dir->List();
-  bool isDir = true;
-
-  if (strcmp(name, ".") == 0)
-    return actualDirectory;
-
-  if (sector >= 0)
-  {
-    isDir = dir->IsDir(name);
-  }
+    return nullptr;
+  int did = directoryTable->FindBySector(sector);
+  if (did != -1)
+    return directoryTable->GetDirectoryInfo(did);
+
+  SynchDirectory *synchDir = dir->synchDir;
+  synchDir->StartLookup(dir->file);
+  bool isDir = synchDir->IsDir(name);
+  synchDir->DoneLookup();
   if (!isDir)
   {
     DEBUG('e', "Tried to open file %s as a directory\n", name);
     return nullptr;
   }
 
-  OpenFile *newDir = nullptr;
-  if (sector >= 0)
+  DEBUG('f', "Opening directory %s in sector %d\n", name, sector);
+  int fid;
+  if ((fid = openFiles->Acquire(sector)) == -1)
   {
-    DEBUG('f', "Opening directory %s\n", name);
-    unsigned did;
-    if ((did = directoryTable->Find(name)) != -1)
-    {
-      DirectoryInfo *dinfo = directoryTable->GetDirectoryInfo(did);
-      return dinfo->file;
-    }
-
     FileHeader *hdr = new FileHeader;
     hdr->FetchFrom(sector);
-    if (strcmp(name, "..") == 0)
-    {
-      unsigned fid;
-      DEBUG('f', "parent sector: %u . Actual sector: %d\n", dir->GetParentSector(), sector);
-      if ((fid = openFiles->FindBySector(dir->GetParentSector())) != -1)
-      {
+    if ((fid = openFiles->Acquire(sector)) != -1)
+      delete hdr;
+    else
+      fid = openFiles->AddFile(name, hdr, new SynchFile, sector);
+  }
+  FileInfo *finfo = openFiles->GetFileInfo(fid);
 
-        FileInfo *finfo = openFiles->GetFileInfo(fid);
-        DEBUG('f', "moving to %s (fid: %u)\n", finfo->name, fid);
-        newDir = new OpenFile(hdr, finfo->synchFile, fid);
-        return newDir;
-      }
-      else
-      {
-        DEBUG('f', "didnt found parent. Sector: %u\n", dir->GetParentSector());
-        ASSERT(false);
-      }
+  // Another thread may have got here first while this one waited for the
+  // disk; the directory it registered keeps the file open.
+  if ((did = directoryTable->FindBySector(sector)) != -1)
+  {
+    finfo->nThreads--;
+    return directoryTable->GetDirectoryInfo(did);
+  }
+  OpenFile *file = new OpenFile(finfo->hdr, finfo->synchFile, fid);
+  did = directoryTable->AddDirectory(name, file, sector, synchDir->GetSector());
+  return directoryTable->GetDirectoryInfo(did);
+}
+
+/// Resolve `path` without touching the current directory of the thread.
+///
+/// The path is relative to the current directory, unless it starts with
+/// `/`.  Every directory on the way is looked up through the name cache
+/// and the table of directories, so that walking a known path reads
+/// nothing from disk.
+///
+/// On success, `*parent` is the directory holding the last component,
+/// `leaf` gets that component, and `*sector` is its header sector, or -1 if
+/// there is no such file.  If the path names a directory (`/`, `a/b/`),
+/// `leaf` is empty and `*parent` is that directory.  Fails if a directory
+/// on the way does not exist.
+///
+/// * `leaf` must have room for `FILE_NAME_MAX_LEN + 1` characters.
+bool FileSystem::Namei(const char *path, DirectoryInfo **parent, char *leaf, int *sector)
+{
+  ASSERT(path != nullptr);
+  ASSERT(parent != nullptr && leaf != nullptr && sector != nullptr);
+
+  OpenFile *start = path[0] == '/' ? rootDirectory : currentThread->GetCurrentDirectory();
+  DirectoryInfo *dir = DirectoryOf(start);
+  ASSERT(dir != nullptr);
+
+  for (;;)
+  {
+    while (*path == '/')
+      path++;
+    if (*path == '\0')
+    {
+      leaf[0] = '\0';
+      *parent = dir;
+      *sector = dir->synchDir->GetSector();
+      return true;
     }
 
-    SynchFile *synchFile = nullptr;
-    unsigned fid;
-    if ((fid = openFiles->Find(name)) != -1)
+    // Longer names are cut, as the directory only compares that much.
+    const char *end = path;
+    while (*end != '\0' && *end != '/')
+      end++;
+    unsigned length = end - path;
+    if (length > FILE_NAME_MAX_LEN)
+      length = FILE_NAME_MAX_LEN;
+    memcpy(leaf, path, length);
+    leaf[length] = '\0';
+    path = end;
+
+    if (*path == '\0')
     {
-      DEBUG('f', "1\n");
-      FileInfo *finfo = openFiles->GetFileInfo(fid);
-      finfo->nThreads++;
-      synchFile = finfo->synchFile;
+      *parent = dir;
+      *sector = Lookup(dir, leaf);
+      return true;
     }
-    else
+    if ((dir = Step(dir, leaf)) == nullptr)
     {
-      DEBUG('f', "2\n");
-      synchFile = new SynchFile;
-      fid = openFiles->AddFile(name, hdr, synchFile);
+      DEBUG('f', "No directory %s on the way\n", leaf);
+      return false;
     }
-    newDir = new OpenFile(hdr, synchFile, fid);
-    DEBUG('z', "%p\n", newDir);
-    if (did == -1)
-      directoryTable->AddDirectory(name, newDir, sector, actualDirectory->GetHdr()->GetInitSector());
   }
-  return newDir;
 }
 
 bool FileSystem::changeDirectory(const char *name)
@@ -895,44 +873,19 @@ bool FileSystem::changeDirectory(const char *name)
     return false;
   }
 
-  OpenFile *temp = currentThread->GetCurrentDirectory();
-  if (name[0] == '/')
-  {
-    currentThread->SetCurrentDirectory(rootDirectory);
-    name++;
-
-    if (name[0] == '\0')
-    {
-      DEBUG('f', "Changed to root directory.\n");
-      // delete temp;
-      return true;
-    }
-  }
+  DirectoryInfo *parent;
+  char leaf[FILE_NAME_MAX_LEN + 1];
+  int sector;
+  DirectoryInfo *target = nullptr;
+  if (Namei(name, &parent, leaf, &sector))
+    target = leaf[0] == '\0' ? parent : Step(parent, leaf);
 
-  char path[strlen(name) + 1];
-  const char *rest = getFilePath(name, path);
-  DEBUG('f', "Path \"%s\".\n", path);
-  OpenFile *newDir = OpenDir(path);
-  bool result = newDir != nullptr;
-  while (strcmp(rest, "") != 0 && result)
+  if (target == nullptr)
   {
-    DEBUG('f', "Changing directory to \"%s\".\n", rest);
-    rest = getFilePath(rest, path);
-    currentThread->SetCurrentDirectory(newDir);
-    DEBUG('f', "Path \"%s\".\n", path);
-    newDir = OpenDir(path);
-    result = newDir != nullptr;
-  }
-
-  if (result)
-  {
-    currentThread->SetCurrentDirectory(newDir);
-    DEBUG('e', "Changed directory to \"%s (id: %d)\".\n", name, newDir->GetId());
-  }
-  else
-  {
-    currentThread->SetCurrentDirectory(temp);
     DEBUG('e', "Could not change directory to \"%s\".\n", name);
+    return false;
   }
-  return result;
-}
\ No newline at end of file
+  currentThread->SetCurrentDirectory(target->file);
+  DEBUG('e', "Changed directory to \"%s (id: %d)\".\n", name, target->file->GetId());
+  return true;
+}
@@ -43,7 +43,6 @@
 /// Constant definitions with dummy values.  For the stub filesystem they
 /// are not required, but system information tools expects them to be
 /// defined.
-static const unsigned FREE_MAP_FILE_SIZE = 0;
 static const unsigned NUM_DIR_ENTRIES = 0;
 static const unsigned DIRECTORY_FILE_SIZE = 0;
 
@@ -93,15 +92,16 @@ public:
 #include "lib/bitmap.hh"
 #include "file_header.hh"
 
-/// Initial file sizes for the bitmap and directory; until the file system
-/// supports extensible files, the directory size sets the maximum number of
-/// files that can be loaded onto the disk.
-static const unsigned FREE_MAP_FILE_SIZE = NUM_SECTORS / BITS_IN_BYTE;
-static const unsigned NUM_DIR_ENTRIES = 10;
+/// Initial file size for directories, which grow as files are added to
+/// them.  The size of the bitmap depends on the disk, see `FreeMapSize`.
+static const unsigned NUM_DIR_ENTRIES = 2 * DIR_ENTRIES_PER_SECTOR;
 static const unsigned DIRECTORY_FILE_SIZE = sizeof(DirectoryEntry) * NUM_DIR_ENTRIES;
 
-class Lock;
+class RWLock;
+class SynchBitmap;
 class DirectoryTable;
+struct DirectoryInfo;
+struct FileInfo;
 class OpenFilesTable;
 class FileSystem
 {
@@ -120,7 +120,6 @@ public:
   bool CreateDirectory(const char *name);
   bool CreateFileDirectory(const char *name, unsigned initialSize, bool isDir);
 
-  bool CreateAtomic(const char *name, unsigned initialSize, bool isDir);
 
   /// Open a file (UNIX `open`).
   OpenFile *Open(const char *name);
@@ -132,8 +131,6 @@ public:
   void List();
 
   void Close(int id);
-  /// Delete a file (UNIX `unlink`).
-  bool Delete(const char *name);
 
   /// Check the filesystem.
   bool Check();
@@ -143,19 +140,52 @@ public:
 
   /// Extend the size of a file.
   bool Extend(unsigned newSize, unsigned id);
+
+  /// Write the delayed changes of an open file to disk (UNIX `fsync`).
+  bool Fsync(unsigned id);
+
+  /// Leave the disk as it should be found when Nachos starts again.
+  void Shutdown();
   bool changeDirectory(const char *name);
-  OpenFile *OpenDir(const char *name);
 
   OpenFile *rootDirectory; ///< “Root” directory -- list of file names,
 private:
   OpenFile *freeMapFile; ///< Bit map of free disk blocks, represented as a
                          ///< file.
                          ///< represented as a file.
-  Lock *freeMapLock;     ///< Lock protecting the free map.
+  SynchBitmap *freeMap;  ///< Resident copy of the free map.
+  RWLock *freeMapLock;   ///< Lock protecting the free map.
   // Lock *directoryLock;     ///< Lock protecting the directory.
 
   DirectoryTable *directoryTable; ///< Table of directories.
   OpenFilesTable *openFiles;      ///< Table of open files.
+  bool clean;                     ///< Is the disk marked clean?
+
+  /// Mark the superblock clean or not.
+  void SetClean(bool value);
+
+  /// Give back the sectors that `Extend` took ahead for a file.
+  void Trim(FileInfo *finfo);
+
+  /// Free the sectors that the free map has taken but no file uses.
+  bool Reclaim();
+
+  /// Find the header sector of `name` in a directory, or -1.
+  int Lookup(DirectoryInfo *dInfo, const char *name);
+
+  /// The entry of the table of directories for an open directory.
+  DirectoryInfo *DirectoryOf(OpenFile *file);
+
+  /// Find the directory `name` inside `dir`.
+  DirectoryInfo *Step(DirectoryInfo *dir, const char *name);
+
+  /// Resolve a path (UNIX `namei`).
+  bool Namei(const char *path, DirectoryInfo **parent, char *leaf, int *sector);
+
+  bool CreateAtomic(DirectoryInfo *dInfo, const char *name, unsigned initialSize, bool isDir);
+
+  /// Take a file out of a directory and free its space.
+  bool Delete(DirectoryInfo *dInfo, const char *name);
 };
 
 #endif
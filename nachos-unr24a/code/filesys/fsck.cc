@@ -0,0 +1,589 @@
+/// Routines to check the file system held in a disk image.
+///
+/// Everything reachable from the root directory is a file; a file is used
+/// if, and only if, it is reached.  So the tree is walked once to list the
+/// files, their headers are checked to count the sectors each one uses, and
+/// then every sector must be used once (or be one of those the file system
+/// keeps for itself, see `disk_layout.hh`) exactly when the free map says
+/// it is taken.
+///
+/// Copyright (c) 1992-1993 The Regents of the University of California.
+///               2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#include "fsck.hh"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+/// Most sectors a file can use: its header, its tables and its data.
+static const unsigned MAX_FILE_SECTORS =
+  1 + NUM_INDIRECT + MAX_FILE_SIZE / SECTOR_SIZE;
+
+static const unsigned PATH_LEN = 256;
+
+/// Is `sector` one of those the file system keeps for itself?
+static bool
+Reserved(unsigned sector)
+{
+  return sector == SUPER_SECTOR || sector == FREE_MAP_SECTOR ||
+         sector == DIRECTORY_SECTOR ||
+         (sector >= JOURNAL_SECTOR && sector < JOURNAL_SECTOR + JOURNAL_SECTORS);
+}
+
+static unsigned
+HashName(const char *name)
+{
+  unsigned h = 5381;
+  for (; *name != '\0'; name++)
+    h = h * 33 + (unsigned char)*name;
+  return h;
+}
+
+unsigned Fsck::NumSectors(const char *super)
+{
+  SuperBlock block;
+  memcpy(&block, super, sizeof block);
+  if (block.magic != SUPER_MAGIC || block.sectorSize != SECTOR_SIZE ||
+      block.sectorsPerTrack == 0 ||
+      block.numTracks > MAX_NUM_SECTORS / block.sectorsPerTrack)
+    return 0;
+  unsigned numSectors = block.sectorsPerTrack * block.numTracks;
+  return numSectors >= MIN_NUM_SECTORS ? numSectors : 0;
+}
+
+Fsck::Fsck(char *image_, unsigned numSectors_, Reporter report_)
+{
+  image = image_;
+  numSectors = numSectors_;
+  freeMapSize = FreeMapSize(numSectors);
+  report = report_;
+  maxFiles = 64;
+  files = new File[maxFiles];
+  numFiles = 0;
+  refs = new unsigned char[numSectors]();
+  seen = new bool[numSectors]();
+  changed = new bool[numSectors]();
+  journalBad = false;
+}
+
+Fsck::~Fsck()
+{
+  delete[] files;
+  delete[] refs;
+  delete[] seen;
+  delete[] changed;
+}
+
+/// Copy the sectors committed to the journal to their place, as
+/// `Journal::Recover` does when Nachos starts.
+unsigned Fsck::ReplayJournal()
+{
+  JournalHeader header;
+  memcpy(&header, Sector(JOURNAL_SECTOR), sizeof header);
+  if (header.magic != JOURNAL_MAGIC || header.count > JOURNAL_SLOTS)
+  {
+    Problem("the journal header is not valid");
+    journalBad = true;
+    return 1;
+  }
+
+  // The map sectors follow each other, so the map can be read as one.
+  const int *map = (const int *)Sector(JOURNAL_FIRST_MAP);
+  for (unsigned i = 0; i < header.count; i++)
+    if (map[i] < 0 || (unsigned)map[i] >= numSectors ||
+        ((unsigned)map[i] >= JOURNAL_SECTOR &&
+         (unsigned)map[i] < JOURNAL_SECTOR + JOURNAL_SECTORS))
+    {
+      Problem("journal slot %u belongs to sector %d, out of place", i, map[i]);
+      journalBad = true;
+      return 1;
+    }
+
+  for (unsigned i = 0; i < header.count; i++)
+  {
+    memcpy(Sector(map[i]), Sector(JOURNAL_FIRST_SLOT + i), SECTOR_SIZE);
+    changed[map[i]] = true;
+  }
+  if (header.count > 0)
+  {
+    header.count = 0;
+    memcpy(Sector(JOURNAL_SECTOR), &header, sizeof header);
+    changed[JOURNAL_SECTOR] = true;
+  }
+  return 0;
+}
+
+/// List the files, a directory before those it holds.
+unsigned Fsck::ScanTree()
+{
+  numFiles = 0;
+  memset(seen, 0, numSectors * sizeof *seen);
+
+  DirectoryEntry freeMap, root;
+  memset(&freeMap, 0, sizeof freeMap);
+  memset(&root, 0, sizeof root);
+  freeMap.sector = FREE_MAP_SECTOR;
+  root.sector = DIRECTORY_SECTOR;
+  root.isDir = true;
+  AddFile(-1, 0, &freeMap);
+  AddFile(-1, 0, &root);
+  seen[FREE_MAP_SECTOR] = seen[DIRECTORY_SECTOR] = true;
+
+  unsigned errors = 0;
+  for (unsigned d = 1; d < numFiles; d++)
+    if (files[d].isDir && !files[d].bad)
+      errors += ScanDirectory(d);
+  return errors;
+}
+
+/// Check the entries of directory `d`, and add the files it holds.
+unsigned Fsck::ScanDirectory(unsigned d)
+{
+  if (!CheckHeader(d, true))
+    return 0;  // `CheckFiles` tells what is wrong with it.
+
+  char path[PATH_LEN];
+  PathOf(d, path, sizeof path);
+  const RawFileHeader *h = Header(d);
+  unsigned n = h->numBytes / sizeof(DirectoryEntry);
+  if (h->numBytes % sizeof(DirectoryEntry) != 0 || n < 2)
+  {
+    Problem("%s: a directory cannot be %u bytes long", path, h->numBytes);
+    files[d].bad = true;
+    return 1;
+  }
+
+  unsigned errors = 0;
+  const DirectoryEntry *dot = EntryOf(d, 0);
+  if (!dot->inUse || strncmp(dot->name, ".", sizeof dot->name) != 0)
+  {
+    // Most likely a file marked as a directory by mistake.
+    Problem("%s: not a directory, it does not start with \".\"", path);
+    if (d == 1)
+      files[d].bad = true;
+    else
+    {
+      files[d].isDir = false;
+      files[d].fixes |= FIX_NOT_DIR;
+    }
+    return 1;
+  }
+  if (dot->sector != files[d].sector || !dot->isDir)
+  {
+    Problem("%s: \".\" does not point to the directory itself", path);
+    files[d].fixes |= FIX_DOT;
+    errors++;
+  }
+  const DirectoryEntry *dotdot = EntryOf(d, 1);
+  unsigned parent = d == 1 ? DIRECTORY_SECTOR : files[files[d].parent].sector;
+  if (!dotdot->inUse || strncmp(dotdot->name, "..", sizeof dotdot->name) != 0 ||
+      dotdot->sector != parent || !dotdot->isDir)
+  {
+    Problem("%s: \"..\" does not point to the parent directory", path);
+    files[d].fixes |= FIX_DOTDOT;
+    errors++;
+  }
+
+  // Repeated names are found through a hash table of entry indexes.
+  unsigned size = 4;
+  while (size < 2 * n)
+    size *= 2;
+  int *names = new int[size];
+  for (unsigned i = 0; i < size; i++)
+    names[i] = -1;
+
+  for (unsigned i = 2; i < n; i++)
+  {
+    const DirectoryEntry *e = EntryOf(d, i);
+    if (!e->inUse)
+      continue;
+
+    unsigned f = AddFile(d, i, e);
+    const char *why = nullptr;
+    if (memchr(e->name, '\0', sizeof e->name) == nullptr)
+      why = "its name has no end";
+    else if (e->name[0] == '\0' || strchr(e->name, '/') != nullptr ||
+             strcmp(e->name, ".") == 0 || strcmp(e->name, "..") == 0)
+      why = "its name is not valid";
+    else if (!Usable(e->sector))
+      why = "its header is out of place";
+    else if (seen[e->sector])
+      why = "its header belongs to another entry too";
+    else
+    {
+      unsigned slot = HashName(e->name) & (size - 1);
+      while (names[slot] != -1 && why == nullptr)
+      {
+        if (strcmp(EntryOf(d, names[slot])->name, e->name) == 0)
+          why = "its name is repeated";
+        slot = (slot + 1) & (size - 1);
+      }
+      if (why == nullptr)
+        names[slot] = i;
+    }
+
+    if (why != nullptr)
+    {
+      PathOf(f, path, sizeof path);
+      Problem("%s (entry %u): %s", path, i, why);
+      files[f].bad = true;
+      errors++;
+      continue;
+    }
+    seen[e->sector] = true;
+  }
+
+  delete[] names;
+  return errors;
+}
+
+unsigned Fsck::CheckFiles(unsigned first, unsigned last, unsigned char *counts)
+{
+  unsigned errors = 0;
+  unsigned *list = new unsigned[MAX_FILE_SECTORS];
+  for (unsigned f = first; f < last && f < numFiles; f++)
+  {
+    if (files[f].bad)
+      continue;
+    if (!CheckHeader(f, false))
+    {
+      files[f].bad = true;
+      errors++;
+      continue;
+    }
+    unsigned n = Sectors(f, list);
+    for (unsigned i = 0; i < n; i++)
+      if (counts[list[i]] < 255)
+        counts[list[i]]++;
+  }
+  delete[] list;
+  return errors;
+}
+
+void Fsck::AddReferences(const unsigned char *counts)
+{
+  for (unsigned s = 0; s < numSectors; s++)
+  {
+    unsigned sum = refs[s] + counts[s];
+    refs[s] = sum < 255 ? sum : 255;
+  }
+}
+
+bool Fsck::IsUsed(unsigned sector) const
+{
+  return Reserved(sector) || refs[sector] > 0;
+}
+
+unsigned Fsck::CheckFreeMap()
+{
+  if (numFiles == 0 || files[0].bad)
+    return 0;  // Already told by `CheckFiles`.
+
+  unsigned *map = new unsigned[freeMapSize / sizeof(unsigned)];
+  LoadFreeMap(map);
+
+  unsigned errors = 0, leaked = 0, firstLeaked = 0;
+  for (unsigned s = 0; s < numSectors; s++)
+  {
+    bool taken = map[s / BITS_IN_WORD] & 1u << s % BITS_IN_WORD;
+    bool used = IsUsed(s);
+    if (refs[s] > 1)
+    {
+      Problem("sector %u is used %u times", s, refs[s]);
+      errors++;
+    }
+    if (used && !taken)
+    {
+      Problem("sector %u is used, but free in the free map", s);
+      errors++;
+    }
+    else if (!used && taken && leaked++ == 0)
+      firstLeaked = s;
+  }
+  // Lost sectors are harmless, and there may be many of them: tell once.
+  if (leaked > 0)
+  {
+    Problem("%u sectors are taken in the free map but not used, from %u on",
+            leaked, firstLeaked);
+    errors++;
+  }
+  delete[] map;
+  return errors;
+}
+
+bool Fsck::Check()
+{
+  unsigned errors = ReplayJournal();
+  errors += ScanTree();
+  errors += CheckFiles(0, numFiles, refs);
+  errors += CheckFreeMap();
+  return errors == 0;
+}
+
+unsigned Fsck::NumFiles() const
+{
+  return numFiles;
+}
+
+/// Files are given their sectors in the order the tree was walked, so that
+/// of two files sharing a sector, the one nearest to the root keeps it.
+bool Fsck::Repair()
+{
+  if (numFiles < 2 || files[0].bad || files[1].bad)
+  {
+    Problem("cannot repair: the free map or the root directory is lost");
+    return false;
+  }
+
+  if (journalBad)
+  {
+    JournalHeader header = { JOURNAL_MAGIC, 0 };
+    memset(Sector(JOURNAL_SECTOR), 0, SECTOR_SIZE);
+    memcpy(Sector(JOURNAL_SECTOR), &header, sizeof header);
+    changed[JOURNAL_SECTOR] = true;
+  }
+
+  memset(refs, 0, numSectors);
+  unsigned *list = new unsigned[MAX_FILE_SECTORS];
+  char path[PATH_LEN];
+  for (unsigned f = 0; f < numFiles; f++)
+  {
+    File *file = &files[f];
+    if (f > 1 && files[file->parent].bad)
+    {
+      file->bad = true;  // Goes away with its directory.
+      continue;
+    }
+    if (!file->bad && !Claim(f, list))
+    {
+      PathOf(f, path, sizeof path);
+      Problem("%s: removed, it shares sectors with another file", path);
+      if (f <= 1)
+      {
+        delete[] list;
+        return false;
+      }
+      file->bad = true;
+    }
+    if (file->bad)
+    {
+      EntryOf(file->parent, file->entry)->inUse = false;
+      ChangeEntry(file->parent, file->entry);
+      continue;
+    }
+
+    if (file->fixes & FIX_NOT_DIR)
+    {
+      EntryOf(file->parent, file->entry)->isDir = false;
+      ChangeEntry(file->parent, file->entry);
+    }
+    if (file->fixes & FIX_DOT)
+    {
+      DirectoryEntry *e = EntryOf(f, 0);
+      e->inUse = e->isDir = true;
+      e->sector = file->sector;
+      ChangeEntry(f, 0);
+    }
+    if (file->fixes & FIX_DOTDOT)
+    {
+      DirectoryEntry *e = EntryOf(f, 1);
+      e->inUse = e->isDir = true;
+      strncpy(e->name, "..", sizeof e->name);
+      e->sector = f == 1 ? DIRECTORY_SECTOR : files[file->parent].sector;
+      ChangeEntry(f, 1);
+    }
+  }
+  delete[] list;
+
+  unsigned *map = new unsigned[freeMapSize / sizeof(unsigned)]();
+  for (unsigned s = 0; s < numSectors; s++)
+    if (Reserved(s) || refs[s] > 0)
+      map[s / BITS_IN_WORD] |= 1u << s % BITS_IN_WORD;
+  StoreFreeMap(map);
+  delete[] map;
+  return true;
+}
+
+/// Can `sector` belong to a file?
+bool Fsck::Usable(unsigned sector) const
+{
+  return sector < numSectors && !Reserved(sector);
+}
+
+bool Fsck::IsChanged(unsigned sector) const
+{
+  return sector < numSectors && changed[sector];
+}
+
+char *Fsck::Sector(unsigned sector) const
+{
+  return &image[sector * SECTOR_SIZE];
+}
+
+const RawFileHeader *Fsck::Header(unsigned f) const
+{
+  return (const RawFileHeader *)Sector(files[f].sector);
+}
+
+/// Sector holding block `k` of the file with header `h`.
+unsigned Fsck::DataSector(const RawFileHeader *h, unsigned k) const
+{
+  const IndirectionTable *t =
+    (const IndirectionTable *)Sector(h->tableSectors[k / NUM_DIRECT]);
+  return t->dataSectors[k % NUM_DIRECT];
+}
+
+/// Entry `i` of directory `f`.  Entries never cross sectors.
+DirectoryEntry *Fsck::EntryOf(unsigned f, unsigned i) const
+{
+  unsigned offset = i * sizeof(DirectoryEntry);
+  char *data = Sector(DataSector(Header(f), offset / SECTOR_SIZE));
+  return (DirectoryEntry *)&data[offset % SECTOR_SIZE];
+}
+
+void Fsck::ChangeEntry(unsigned f, unsigned i)
+{
+  unsigned offset = i * sizeof(DirectoryEntry);
+  changed[DataSector(Header(f), offset / SECTOR_SIZE)] = true;
+}
+
+unsigned Fsck::AddFile(int parent, unsigned entry, const DirectoryEntry *e)
+{
+  if (numFiles == maxFiles)
+  {
+    File *bigger = new File[2 * maxFiles];
+    memcpy(bigger, files, numFiles * sizeof *files);
+    delete[] files;
+    files = bigger;
+    maxFiles *= 2;
+  }
+  File *file = &files[numFiles];
+  file->sector = e->sector;
+  file->parent = parent;
+  file->entry = entry;
+  file->isDir = e->isDir;
+  file->bad = false;
+  file->fixes = 0;
+  strncpy(file->name, e->name, FILE_NAME_MAX_LEN);
+  file->name[FILE_NAME_MAX_LEN] = '\0';
+  return numFiles++;
+}
+
+/// Check that the header of file `f` only points to sectors a file can
+/// have.  Problems are not told if `quiet`.
+bool Fsck::CheckHeader(unsigned f, bool quiet) const
+{
+  const RawFileHeader *h = Header(f);
+  char path[PATH_LEN];
+  if (!quiet)
+    PathOf(f, path, sizeof path);
+
+  if (h->numBytes > MAX_FILE_SIZE || (f == 0 && h->numBytes != freeMapSize))
+  {
+    if (!quiet)
+      Problem("%s: cannot be %u bytes long", path, h->numBytes);
+    return false;
+  }
+  unsigned numBlocks = DivRoundUp(h->numBytes, SECTOR_SIZE);
+  unsigned numTables = DivRoundUp(numBlocks, NUM_DIRECT);
+  for (unsigned t = 0; t < numTables; t++)
+    if (!Usable(h->tableSectors[t]))
+    {
+      if (!quiet)
+        Problem("%s: table %u is in sector %u, out of place",
+                path, t, h->tableSectors[t]);
+      return false;
+    }
+  for (unsigned k = 0; k < numBlocks; k++)
+    if (!Usable(DataSector(h, k)))
+    {
+      if (!quiet)
+        Problem("%s: block %u is in sector %u, out of place",
+                path, k, DataSector(h, k));
+      return false;
+    }
+  return true;
+}
+
+/// Put in `list` the sectors used by file `f`, and return how many.
+unsigned Fsck::Sectors(unsigned f, unsigned *list) const
+{
+  const RawFileHeader *h = Header(f);
+  unsigned numBlocks = DivRoundUp(h->numBytes, SECTOR_SIZE);
+  unsigned numTables = DivRoundUp(numBlocks, NUM_DIRECT);
+  unsigned n = 0;
+  list[n++] = files[f].sector;
+  for (unsigned t = 0; t < numTables; t++)
+    list[n++] = h->tableSectors[t];
+  for (unsigned k = 0; k < numBlocks; k++)
+    list[n++] = DataSector(h, k);
+  return n;
+}
+
+/// Count the sectors of file `f` as used, unless some of them already are
+/// (or the file uses one twice); then count none of them.
+bool Fsck::Claim(unsigned f, unsigned *list)
+{
+  unsigned n = Sectors(f, list);
+  for (unsigned i = 0; i < n; i++)
+  {
+    if (refs[list[i]] > 0)
+    {
+      while (i-- > 0)
+        refs[list[i]]--;
+      return false;
+    }
+    refs[list[i]] = 1;
+  }
+  return true;
+}
+
+void Fsck::LoadFreeMap(unsigned *map) const
+{
+  const RawFileHeader *h = Header(0);
+  for (unsigned k = 0; k * SECTOR_SIZE < freeMapSize; k++)
+  {
+    unsigned size = freeMapSize - k * SECTOR_SIZE;
+    memcpy((char *)map + k * SECTOR_SIZE, Sector(DataSector(h, k)),
+           size < SECTOR_SIZE ? size : SECTOR_SIZE);
+  }
+}
+
+void Fsck::StoreFreeMap(const unsigned *map)
+{
+  const RawFileHeader *h = Header(0);
+  for (unsigned k = 0; k * SECTOR_SIZE < freeMapSize; k++)
+  {
+    unsigned size = freeMapSize - k * SECTOR_SIZE;
+    memcpy(Sector(DataSector(h, k)), (const char *)map + k * SECTOR_SIZE,
+           size < SECTOR_SIZE ? size : SECTOR_SIZE);
+    changed[DataSector(h, k)] = true;
+  }
+}
+
+/// Write in `path` where file `f` is found, for messages.
+void Fsck::PathOf(unsigned f, char *path, unsigned size) const
+{
+  if (f <= 1)
+  {
+    snprintf(path, size, f == 0 ? "free map" : "/");
+    return;
+  }
+  PathOf(files[f].parent, path, size);
+  unsigned length = strlen(path);
+  snprintf(path + length, size - length, "%s%s",
+           files[f].parent == 1 ? "" : "/", files[f].name);
+}
+
+void Fsck::Problem(const char *format, ...) const
+{
+  char message[2 * PATH_LEN];
+  va_list args;
+  va_start(args, format);
+  vsnprintf(message, sizeof message, format, args);
+  va_end(args);
+  report(message);
+}
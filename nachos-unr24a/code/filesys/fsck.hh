@@ -0,0 +1,121 @@
+/// A checker for the structures of the file system on disk.
+///
+/// Copyright (c) 1992-1993 The Regents of the University of California.
+///               2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_FILESYS_FSCK__HH
+#define NACHOS_FILESYS_FSCK__HH
+
+#include "disk_layout.hh"
+#include "directory_entry.hh"
+#include "raw_file_header.hh"
+
+/// Checks, and optionally repairs, a whole file system held in memory.
+///
+/// The disk is read once, in order, into `image`; after that no sector is
+/// read again, so checking costs one sweep of the disk no matter how the
+/// files are laid out.  It goes in phases:
+///
+/// 1. `ReplayJournal` finishes the operations committed to the journal.
+/// 2. `ScanTree` walks the directories from the root, and lists every file
+///    reached, checking the entries on the way.
+/// 3. `CheckFiles` checks the headers of a range of those files, and counts
+///    how many times each sector is used.  Ranges do not share anything
+///    but the image, which is only read, so several threads may check
+///    them at once, each with its own counts, merged with `AddReferences`.
+/// 4. `CheckFreeMap` compares the free map with the counts.
+///
+/// `Check` runs all of them in order.  Problems are passed to `report` as
+/// they are found.  Nothing here uses the rest of Nachos, so that programs
+/// outside of it can check a `DISK` file as well (see `bin/fsck`).
+class Fsck
+{
+public:
+  typedef void (*Reporter)(const char *message);
+
+  /// Number of sectors of the disk whose superblock is `super`, or 0 if it
+  /// does not look like one.
+  static unsigned NumSectors(const char *super);
+
+  /// `image` holds every sector of the disk, in order.
+  Fsck(char *image, unsigned numSectors, Reporter report);
+  ~Fsck();
+
+  /// Each of these returns the number of problems found.
+  unsigned ReplayJournal();
+  unsigned ScanTree();
+  unsigned CheckFiles(unsigned first, unsigned last, unsigned char *counts);
+  unsigned CheckFreeMap();
+
+  /// Run all of the above; return true if nothing is wrong.
+  bool Check();
+
+  /// Files found by `ScanTree`, the free map and root directory included.
+  unsigned NumFiles() const;
+
+  /// Add the uses of each sector counted by some call to `CheckFiles`.
+  void AddReferences(const unsigned char *counts);
+
+  /// Is `sector` used by the file system, as far as the references added
+  /// so far tell?
+  bool IsUsed(unsigned sector) const;
+
+  /// Change the image so that the problems found go away: remove the
+  /// entries of broken files, and of those sharing sectors with others,
+  /// fix the entries of directories and rebuild the free map.  Returns
+  /// false if the free map or the root directory cannot be recovered.
+  bool Repair();
+
+  /// Was `sector` changed in the image, by the journal or by `Repair`?
+  bool IsChanged(unsigned sector) const;
+
+private:
+  /// What `ScanTree` learns of each file.
+  struct File
+  {
+    unsigned sector;  ///< Of the header.
+    int parent;       ///< Index of the directory holding it.
+    unsigned entry;   ///< Index of its entry there.
+    bool isDir;
+    bool bad;         ///< Its entry or its header cannot be trusted.
+    unsigned fixes;   ///< Entries to correct if repairing.
+    char name[FILE_NAME_MAX_LEN + 1];
+  };
+
+  static const unsigned FIX_DOT = 1;
+  static const unsigned FIX_DOTDOT = 2;
+  static const unsigned FIX_NOT_DIR = 4;
+
+  char *image;
+  unsigned numSectors;
+  unsigned freeMapSize;
+  Reporter report;
+  File *files;
+  unsigned numFiles;
+  unsigned maxFiles;
+  unsigned char *refs;  ///< Uses of each sector, up to 255.
+  bool *seen;           ///< Sectors holding a header reached by the tree.
+  bool *changed;
+  bool journalBad;
+
+  bool Usable(unsigned sector) const;
+  char *Sector(unsigned sector) const;
+  const RawFileHeader *Header(unsigned f) const;
+  unsigned DataSector(const RawFileHeader *h, unsigned k) const;
+  DirectoryEntry *EntryOf(unsigned f, unsigned i) const;
+  void ChangeEntry(unsigned f, unsigned i);
+
+  unsigned AddFile(int parent, unsigned entry, const DirectoryEntry *e);
+  unsigned ScanDirectory(unsigned d);
+  bool CheckHeader(unsigned f, bool quiet) const;
+  unsigned Sectors(unsigned f, unsigned *list) const;
+  bool Claim(unsigned f, unsigned *list);
+  void LoadFreeMap(unsigned *map) const;
+  void StoreFreeMap(const unsigned *map);
+  void PathOf(unsigned f, char *path, unsigned size) const;
+  void Problem(const char *format, ...) const;
+};
+
+#endif
@@ -0,0 +1,290 @@
+/// Routines for the metadata journal.
+///
+/// The journal area looks like this on disk:
+///
+///     header | map | slot 0 | slot 1 | ...
+///
+/// The header holds the number of slots in use; the map holds, for each
+/// slot, the sector it belongs to.  Writing the header is what commits a
+/// group of operations: slots and map are written before it, so a crash
+/// halfway leaves the header counting the slots of the earlier groups only.
+///
+/// Copyright (c) 1992-1993 The Regents of the University of California.
+///               2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#include "journal.hh"
+#include "threads/system.hh"
+
+#include <string.h>
+
+Journal::Journal(SynchDisk *disk)
+{
+  ASSERT(disk != nullptr);
+
+  synchDisk = disk;
+  lock = new Lock("journal");
+  idle = new Condition("journal idle", lock);
+  members = new List<Thread *>;
+  outstanding = 0;
+  busy = false;
+  pendingData = new char[JOURNAL_SLOTS][SECTOR_SIZE];
+  numPending = 0;
+  numCommitted = 0;
+}
+
+Journal::~Journal()
+{
+  if (numPending > 0)
+    DEBUG('f', "Journal: %u uncommitted sectors are lost\n", numPending);
+  delete[] pendingData;
+  delete members;
+  delete idle;
+  delete lock;
+}
+
+void Journal::Format()
+{
+  WriteHeader(0);
+}
+
+void Journal::Recover()
+{
+  char buffer[SECTOR_SIZE];
+  synchDisk->ReadSector(JOURNAL_SECTOR, buffer);
+  JournalHeader header;
+  memcpy(&header, buffer, sizeof header);
+  if (header.magic != JOURNAL_MAGIC)
+  {
+    DEBUG('f', "Journal: no journal on disk\n");
+    return;
+  }
+  ASSERT(header.count <= JOURNAL_SLOTS);
+  if (header.count == 0)
+    return;
+
+  DEBUG('f', "Journal: replaying %u sectors\n", header.count);
+  int map[JOURNAL_MAP_SECTORS * JOURNAL_MAP_ENTRIES];
+  synchDisk->ReadSectors(JOURNAL_FIRST_MAP, JOURNAL_MAP_SECTORS, (char *)map);
+  // Nothing is pending yet, so the slots can be read into its room.
+  synchDisk->ReadSectors(JOURNAL_FIRST_SLOT, header.count, pendingData[0]);
+  for (unsigned i = 0; i < header.count; i++)
+    blockCache->Store(map[i], pendingData[i]);
+  blockCache->Sync();
+  WriteHeader(0);
+}
+
+/// An operation waits while the journal is being written, and also while
+/// enough sectors are pending that the group running now should be
+/// committed first (right away, if nobody is left in it).
+void Journal::Begin()
+{
+  lock->Acquire();
+  if (!members->Has(currentThread))
+  {
+    while (busy || numPending > (outstanding == 0 ? 0 : JOURNAL_SLOTS / 2))
+      idle->Wait();
+    outstanding++;
+  }
+  members->Prepend(currentThread);
+  lock->Release();
+}
+
+void Journal::End()
+{
+  lock->Acquire();
+  ASSERT(members->Has(currentThread));
+  members->Remove(currentThread);
+  if (!members->Has(currentThread) && --outstanding == 0)
+  {
+    if (numPending > 0)
+    {
+      StartWriting();
+      Commit();
+      DoneWriting();
+    }
+    idle->Broadcast();
+  }
+  lock->Release();
+}
+
+bool Journal::Log(int sector, const char *data)
+{
+  ASSERT(data != nullptr);
+
+  if (outstanding == 0 && numCommitted == 0)
+    return false;
+
+  lock->Acquire();
+  while (busy)
+    idle->Wait();
+  if (!members->Has(currentThread))
+  {
+    // A sector that the running group changed stays with it, or the group
+    // would later put an older copy over this write.
+    for (unsigned i = 0; i < numPending; i++)
+      if (pendingSectors[i] == sector)
+      {
+        memcpy(pendingData[i], data, SECTOR_SIZE);
+        lock->Release();
+        return true;
+      }
+    // Same for a replay of the journal.
+    for (unsigned i = 0; i < numCommitted; i++)
+      if (committedSectors[i] == sector)
+      {
+        StartWriting();
+        Empty();
+        DoneWriting();
+        break;
+      }
+    lock->Release();
+    return false;
+  }
+
+  unsigned i = 0;
+  while (i < numPending && pendingSectors[i] != sector)
+    i++;
+  if (i == numPending)
+  {
+    if (numCommitted + numPending == JOURNAL_SLOTS)
+    {
+      StartWriting();
+      if (numCommitted > 0)
+        Empty();
+      if (numPending == JOURNAL_SLOTS)
+        Spill();
+      DoneWriting();
+    }
+    i = numPending++;
+    pendingSectors[i] = sector;
+  }
+  memcpy(pendingData[i], data, SECTOR_SIZE);
+  lock->Release();
+  return true;
+}
+
+bool Journal::Read(int sector, char *data)
+{
+  ASSERT(data != nullptr);
+
+  if (numPending == 0)
+    return false;
+
+  lock->Acquire();
+  bool found = false;
+  for (unsigned i = 0; i < numPending; i++)
+    if (pendingSectors[i] == sector)
+    {
+      memcpy(data, pendingData[i], SECTOR_SIZE);
+      found = true;
+      break;
+    }
+  lock->Release();
+  return found;
+}
+
+void Journal::Checkpoint()
+{
+  lock->Acquire();
+  if (numCommitted > 0)
+  {
+    StartWriting();
+    Empty();
+    DoneWriting();
+  }
+  lock->Release();
+}
+
+/// Write the pending sectors to the journal, then hand them to the block
+/// cache.
+void Journal::Commit()
+{
+  if (numCommitted + numPending > JOURNAL_SLOTS)
+    Empty();
+
+  DEBUG('f', "Journal: committing %u sectors\n", numPending);
+  unsigned first = numCommitted, last = numCommitted + numPending;
+  int map[JOURNAL_MAP_ENTRIES];
+  for (unsigned m = first / JOURNAL_MAP_ENTRIES; m <= (last - 1) / JOURNAL_MAP_ENTRIES; m++)
+  {
+    for (unsigned j = 0; j < JOURNAL_MAP_ENTRIES; j++)
+    {
+      unsigned slot = m * JOURNAL_MAP_ENTRIES + j;
+      if (slot < first)
+        map[j] = committedSectors[slot];
+      else if (slot < last)
+        map[j] = pendingSectors[slot - first];
+      else
+        map[j] = -1;
+    }
+    synchDisk->WriteSector(JOURNAL_FIRST_MAP + m, (char *)map);
+  }
+  synchDisk->WriteSectors(JOURNAL_FIRST_SLOT + first, numPending, pendingData[0]);
+  WriteHeader(last);
+
+  for (unsigned i = 0; i < numPending; i++)
+  {
+    blockCache->Store(pendingSectors[i], pendingData[i]);
+    committedSectors[first + i] = pendingSectors[i];
+  }
+  numCommitted = last;
+  stats->numJournalCommits++;
+  stats->numJournalSectors += numPending;
+  numPending = 0;
+}
+
+/// Write the committed sectors to their place, so that the journal can be
+/// reused from the start.
+void Journal::Empty()
+{
+  DEBUG('f', "Journal: checkpointing %u sectors\n", numCommitted);
+  // In ascending order, so that they go out in few disk requests.
+  int sectors[JOURNAL_SLOTS];
+  for (unsigned i = 0; i < numCommitted; i++)
+  {
+    unsigned j = i;
+    for (; j > 0 && sectors[j - 1] > committedSectors[i]; j--)
+      sectors[j] = sectors[j - 1];
+    sectors[j] = committedSectors[i];
+  }
+  blockCache->SyncSectors(sectors, numCommitted);
+  WriteHeader(0);
+  numCommitted = 0;
+}
+
+/// Give up on logging the running group, which does not fit in the
+/// journal: its sectors go to the block cache as they are.
+void Journal::Spill()
+{
+  DEBUG('f', "Journal: %u sectors do not fit, writing them unlogged\n", numPending);
+  for (unsigned i = 0; i < numPending; i++)
+    blockCache->Store(pendingSectors[i], pendingData[i]);
+  numPending = 0;
+}
+
+/// Wait for the journal area, and release the lock while writing to it.
+void Journal::StartWriting()
+{
+  while (busy)
+    idle->Wait();
+  busy = true;
+  lock->Release();
+}
+
+void Journal::DoneWriting()
+{
+  lock->Acquire();
+  busy = false;
+  idle->Broadcast();
+}
+
+void Journal::WriteHeader(unsigned count)
+{
+  char buffer[SECTOR_SIZE];
+  memset(buffer, 0, SECTOR_SIZE);
+  JournalHeader header = { JOURNAL_MAGIC, count };
+  memcpy(buffer, &header, sizeof header);
+  synchDisk->WriteSector(JOURNAL_SECTOR, buffer);
+}
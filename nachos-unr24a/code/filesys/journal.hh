@@ -0,0 +1,87 @@
+/// A write-ahead journal for the metadata of the file system.
+///
+/// Copyright (c) 1992-1993 The Regents of the University of California.
+///               2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_FILESYS_JOURNAL__HH
+#define NACHOS_FILESYS_JOURNAL__HH
+
+#include "disk_layout.hh"
+#include "synch_disk.hh"
+#include "lib/list.hh"
+#include "threads/condition.hh"
+
+class Thread;
+
+/// Makes every operation on the file system metadata (creating a file,
+/// removing it, making it longer) reach the disk whole or not at all, even
+/// if Nachos stops in the middle.
+///
+/// A thread brackets the operation with `Begin` and `End`.  Sectors it
+/// writes in between are kept by the journal instead of the block cache
+/// (reads see them all the same).  When the last operation in progress
+/// ends, the sectors of all of them are committed together: written one
+/// after the other to the journal area, followed by the header that counts
+/// them.  Only then are they handed to the block cache, and the flusher
+/// writes them to their place whenever it gets to it.
+///
+/// Committed sectors stay in the journal until it fills up or `Checkpoint`
+/// is called; then they are written to their place and the journal is
+/// emptied.  `Recover` copies whatever the journal holds to its place,
+/// which finishes the operations committed before a crash.
+class Journal
+{
+public:
+  Journal(SynchDisk *disk);
+  ~Journal();
+
+  /// Write an empty journal, for a new file system.
+  void Format();
+
+  /// Replay the journal left on disk, if any, and empty it.
+  void Recover();
+
+  /// Start an operation of the current thread.  Operations may nest; the
+  /// outermost one counts.
+  void Begin();
+
+  /// Finish an operation of the current thread.
+  void End();
+
+  /// If the current thread is inside an operation, keep `data` as the new
+  /// contents of `sector` and return true.
+  bool Log(int sector, const char *data);
+
+  /// If `sector` was written by an operation not committed yet, copy its
+  /// new contents to `data` and return true.
+  bool Read(int sector, char *data);
+
+  /// Write every committed sector to its place and empty the journal.
+  void Checkpoint();
+
+private:
+  SynchDisk *synchDisk;
+  Lock *lock;
+  Condition *idle;          ///< Signalled when a commit or checkpoint ends.
+  List<Thread *> *members;  ///< Threads inside an operation, once per level.
+  unsigned outstanding;     ///< Operations in progress.
+  bool busy;                ///< A commit or checkpoint is writing.
+
+  int pendingSectors[JOURNAL_SLOTS];  ///< Written by the running group.
+  char (*pendingData)[SECTOR_SIZE];
+  unsigned numPending;
+
+  int committedSectors[JOURNAL_SLOTS];  ///< Logged, maybe not in place.
+  unsigned numCommitted;
+
+  void Commit();
+  void Empty();
+  void Spill();
+  void StartWriting();
+  void DoneWriting();
+  void WriteHeader(unsigned count);
+};
+
+#endif
@@ -0,0 +1,98 @@
+/// Routines for the file name lookup cache.
+///
+/// Copyright (c) 1992-1993 The Regents of the University of California.
+///               2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#include "name_cache.hh"
+#include "lib/utility.hh"
+
+#include <string.h>
+
+unsigned HashName(const char *name)
+{
+  ASSERT(name != nullptr);
+
+  unsigned h = 5381;
+  for (unsigned i = 0; i < FILE_NAME_MAX_LEN && name[i] != '\0'; i++)
+    h = h * 33 + (unsigned char)name[i];
+  return h;
+}
+
+NameCache::NameCache()
+{
+  for (unsigned i = 0; i < NAME_CACHE_SIZE; i++)
+    entries[i].inUse = false;
+  for (unsigned i = 0; i < NAME_CACHE_BUCKETS; i++)
+    buckets[i] = nullptr;
+  nextVictim = 0;
+}
+
+bool NameCache::Lookup(unsigned dir, const char *name, int *sector)
+{
+  ASSERT(sector != nullptr);
+
+  Entry *e = Find(dir, name);
+  if (e == nullptr)
+    return false;
+  *sector = e->sector;
+  return true;
+}
+
+void NameCache::Enter(unsigned dir, const char *name, int sector)
+{
+  Entry *e = Find(dir, name);
+  if (e == nullptr)
+  {
+    e = &entries[nextVictim];
+    nextVictim = (nextVictim + 1) % NAME_CACHE_SIZE;
+    if (e->inUse)
+      Unlink(e);
+
+    e->inUse = true;
+    e->dir = dir;
+    strncpy(e->name, name, FILE_NAME_MAX_LEN);
+    e->name[FILE_NAME_MAX_LEN] = '\0';
+    unsigned b = Bucket(dir, name);
+    e->next = buckets[b];
+    buckets[b] = e;
+  }
+  e->sector = sector;
+}
+
+void NameCache::Forget(unsigned dir, const char *name)
+{
+  Entry *e = Find(dir, name);
+  if (e != nullptr)
+    Unlink(e);
+}
+
+void NameCache::Purge(unsigned dir)
+{
+  for (unsigned i = 0; i < NAME_CACHE_SIZE; i++)
+    if (entries[i].inUse && entries[i].dir == dir)
+      Unlink(&entries[i]);
+}
+
+NameCache::Entry *NameCache::Find(unsigned dir, const char *name)
+{
+  for (Entry *e = buckets[Bucket(dir, name)]; e != nullptr; e = e->next)
+    if (e->dir == dir && strncmp(e->name, name, FILE_NAME_MAX_LEN) == 0)
+      return e;
+  return nullptr;
+}
+
+void NameCache::Unlink(Entry *e)
+{
+  Entry **p = &buckets[Bucket(e->dir, e->name)];
+  while (*p != e)
+    p = &(*p)->next;
+  *p = e->next;
+  e->inUse = false;
+}
+
+unsigned NameCache::Bucket(unsigned dir, const char *name)
+{
+  return (HashName(name) + dir * 31) % NAME_CACHE_BUCKETS;
+}
@@ -0,0 +1,67 @@
+/// A cache of file name lookups.
+///
+/// Copyright (c) 1992-1993 The Regents of the University of California.
+///               2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_FILESYS_NAMECACHE__HH
+#define NACHOS_FILESYS_NAMECACHE__HH
+
+#include "directory_entry.hh"
+
+/// Number of lookups remembered.
+const unsigned NAME_CACHE_SIZE = 128;
+
+/// Number of hash buckets used to find them.
+const unsigned NAME_CACHE_BUCKETS = 64;
+
+/// Hash of a file name, as far as names are compared.
+unsigned HashName(const char *name);
+
+/// Remembers the header sector that a name stands for in a directory, and
+/// also which names a directory is known not to have.  Directories are
+/// identified by the sector of their header.
+///
+/// Entries are only added by threads holding the directory's lock, and
+/// every change to a directory forgets the names it touches, so what is
+/// here always matches the directory.  When the cache is full, entries are
+/// replaced in turn.
+class NameCache
+{
+public:
+  NameCache();
+
+  /// Look `name` up in directory `dir`.  Return true if it is known; then
+  /// `*sector` is where its header is, or -1 if it is not there.
+  bool Lookup(unsigned dir, const char *name, int *sector);
+
+  /// Remember that `name` in `dir` is at `sector` (-1 if absent).
+  void Enter(unsigned dir, const char *name, int sector);
+
+  /// Forget what is known about `name` in `dir`.
+  void Forget(unsigned dir, const char *name);
+
+  /// Forget everything known about directory `dir`.
+  void Purge(unsigned dir);
+
+private:
+  struct Entry
+  {
+    bool inUse;
+    unsigned dir;
+    int sector;
+    char name[FILE_NAME_MAX_LEN + 1];
+    Entry *next; ///< Next entry in the same bucket.
+  };
+
+  Entry entries[NAME_CACHE_SIZE];
+  Entry *buckets[NAME_CACHE_BUCKETS];
+  unsigned nextVictim;
+
+  Entry *Find(unsigned dir, const char *name);
+  void Unlink(Entry *e);
+  static unsigned Bucket(unsigned dir, const char *name);
+};
+
+#endif
@@ -3,31 +3,32 @@
 
 OpenFilesTable::OpenFilesTable()
 {
-  table = new Table<FileInfo *>;
+  numClosed = 0;
 }
 
 OpenFilesTable::~OpenFilesTable()
 {
-  delete table;
+  for (unsigned i = 0; i < files.Size(); i++)
+    if (files.HasKey(i))
+      RemoveFile(i);
 }
 
-int OpenFilesTable::AddFile(const char *name, FileHeader *hdr, SynchFile *synch)
+int OpenFilesTable::AddFile(const char *name, FileHeader *hdr, SynchFile *synch, unsigned sector)
 {
-  int id;
-
-  if (name && (id = Find(name)) != -1)
-    return id;
+  ASSERT(FindBySector(sector) == -1);
 
   FileInfo *info = new FileInfo;
   info->hdr = hdr;
+  info->sector = sector;
   info->synchFile = synch;
   info->available = true;
   info->nThreads = 1;
+  info->name[0] = '\0';
   if (name)
     strncpy(info->name, name, FILE_NAME_MAX_LEN);
 
-  if ((id = table->Add(info)) == -1)
-    delete info;
+  int id = files.Add(info, sector);
+  info->id = id;
   DEBUG('f', "'OpenFilesTable::AddFile'name: %s,  id file: %d\n", info->name, id);
 
   return id;
@@ -35,34 +36,63 @@ int OpenFilesTable::AddFile(const char *name, FileHeader *hdr, SynchFile *synch)
 
 void OpenFilesTable::RemoveFile(int id)
 {
-  FileInfo *info = table->Remove(id);
-  info->synchFile = NULL;
+  FileInfo *info = GetFileInfo(id);
+  ASSERT(info != nullptr);
+
+  if (closed.Has(id))
+  {
+    closed.Remove(id);
+    numClosed--;
+  }
+  files.Remove(id);
+
+  delete info->hdr;
+  delete info->synchFile;
   delete info;
 }
 
-int OpenFilesTable::Find(const char *name)
+int OpenFilesTable::FindBySector(unsigned sector)
 {
-  ASSERT(name != nullptr);
+  return files.Find(sector);
+}
+
+int OpenFilesTable::Acquire(unsigned sector)
+{
+  int id = FindBySector(sector);
+  if (id == -1)
+    return -1;
 
-  for (unsigned i = 0; i < table->SIZE; i++)
+  FileInfo *info = files.Get(id);
+  if (info->nThreads++ == 0)
   {
-    if (table->HasKey(i) && strncmp(table->Get(i)->name, name, FILE_NAME_MAX_LEN) == 0)
-      return i;
+    closed.Remove(id);
+    numClosed--;
   }
-  return -1;
+  return id;
 }
 
-FileInfo *OpenFilesTable::GetFileInfo(int id)
+void OpenFilesTable::Release(int id)
 {
-  return table->Get(id);
-}
+  FileInfo *info = GetFileInfo(id);
+  ASSERT(info != nullptr && info->nThreads == 0);
 
-int OpenFilesTable::FindBySector(int sector)
-{
-  for (unsigned i = 0; i < table->SIZE; i++)
+  closed.Append(id);
+  if (++numClosed > RETAINED)
   {
-    if (table->HasKey(i) && table->Get(i)->hdr->GetInitSector() == sector)
-      return i;
+    int oldest = closed.Head();
+    DEBUG('f', "Dropping header of sector %u from memory\n", files.Get(oldest)->sector);
+    RemoveFile(oldest);
   }
-  return -1;
-};
\ No newline at end of file
+}
+
+unsigned OpenFilesTable::Size() const
+{
+  return files.Size();
+}
+
+FileInfo *OpenFilesTable::GetFileInfo(int id)
+{
+  if (id < 0)
+    return nullptr;
+  return files.Get(id);
+}
@@ -1,43 +1,74 @@
 #ifndef NACHOS_FILESYS_OPENFILESTABLE__HH
 #define NACHOS_FILESYS_OPENFILESTABLE__HH
+#include "lib/list.hh"
 #include "lib/table.hh"
+#include "directory_entry.hh"
 #include "file_header.hh"
 #include "synchFile.hh"
 
-#ifndef NACHOS_FILESYS_DIRECTORYENTRY__HH
-/// For simplicity, we assume file names are <= 9 characters long.
-const unsigned FILE_NAME_MAX_LEN = 9;
-#endif
-
 struct FileInfo
 {
   // Name of the file
   char name[FILE_NAME_MAX_LEN + 1];
   // Header of the file
   FileHeader *hdr;
+  // Sector where the header lives on disk
+  unsigned sector;
   // Used to synchronize threads with the same file open
   SynchFile *synchFile;
   // False if the file was deleted and cannot be opened anymore, true otherwise
   bool available;
+  // Directory to take the file out of when it is no longer available
+  unsigned dirSector;
   // Number of threads currently accesing this file
   unsigned nThreads;
+  // Index in the table
+  int id;
 };
 
+/// The in-memory file headers (i-nodes), looked up by header sector.
+///
+/// A file stays here while somebody has it open.  After the last close it
+/// is kept a while longer, so that opening it again (an executable that is
+/// run often, for instance) does not read its header from disk; only the
+/// `RETAINED` most recently closed files are kept.
+///
+/// Files are also known by an id, which `OpenFile` remembers.  There is no
+/// limit on how many files can be open at once.
 class OpenFilesTable
 {
 public:
+  /// Closed files that are kept in memory.
+  static const unsigned RETAINED = 16;
+
   OpenFilesTable();
   ~OpenFilesTable();
-  int AddFile(const char *name, FileHeader *hdr, SynchFile *synch);
+
+  /// Add file with header `hdr`, read from `sector`, opened once.
+  int AddFile(const char *name, FileHeader *hdr, SynchFile *synch, unsigned sector);
+
+  /// Forget file `id`, deleting its header and `SynchFile`.
   void RemoveFile(int id);
 
-  int Find(const char *name);
+  /// Return the id of the file whose header is at `sector`, or -1.
+  int FindBySector(unsigned sector);
 
+  /// Like `FindBySector`, and count one more user of the file.
+  int Acquire(unsigned sector);
+
+  /// The last user of file `id` closed it; keep it for a while.
+  void Release(int id);
+
+  /// Null if no file has id `id`.
   FileInfo *GetFileInfo(int id);
-  int FindBySector(int sector);
+
+  /// One more than the greatest id in use, to walk the table.
+  unsigned Size() const;
 
 private:
-  Table<FileInfo *> *table;
+  Table<FileInfo *> files;  ///< Files by id, keyed by sector.
+  List<int> closed;     ///< Files nobody has open, oldest first.
+  unsigned numClosed;
 };
 
-#endif
\ No newline at end of file
+#endif
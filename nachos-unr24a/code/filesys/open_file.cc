@@ -13,11 +13,11 @@
 #include "open_file.hh"
 #include <string.h>
 #include "threads/system.hh"
-#include "synch_disk.hh"
+#include "block_cache.hh"
 #include "synchFile.hh"
 #include "file_header.hh"
 
-extern SynchDisk *synchDisk;
+extern BlockCache *blockCache;
 /// Open a Nachos file for reading and writing.  Bring the file header into
 /// memory while the file is open.
 ///
@@ -28,6 +28,9 @@ OpenFile::OpenFile(FileHeader *sharedHdr, SynchFile *synch, unsigned fId)
   id = fId;
   synchFile = synch;
   seekPosition = 0;
+  nextSector = 0;
+  raWindow = 0;
+  raEnd = 0;
 }
 
 /// Close a Nachos file, de-allocating any in-memory data structures.
@@ -88,13 +91,14 @@ int OpenFile::Write(const char *into, unsigned numBytes)
 /// sector at a time.  Thus:
 ///
 /// For ReadAt:
-///     We read in all of the full or partial sectors that are part of the
-///     request, but we only copy the part we are interested in.
+///     Sectors wholly inside the request are read straight into `into`.
+///     The partial sectors at either end are read into a buffer of one
+///     sector, and only the part we are interested in is copied.
 /// For WriteAt:
-///     We must first read in any sectors that will be partially written, so
-///     that we do not overwrite the unmodified portion.  We then copy in the
-///     data that will be modified, and write back all the full or partial
-///     sectors that are part of the request.
+///     Sectors wholly inside the request are written straight from `from`.
+///     A sector to be partially written is read first, so that we do not
+///     overwrite the unmodified portion, unless it lies past the old end
+///     of the file; then the new bytes are copied in and it is written back.
 ///
 /// * `into` is the buffer to contain the data to be read from disk.
 /// * `from` is the buffer containing the data to be written to disk.
@@ -113,8 +117,7 @@ int OpenFile::ReadAt(char *into, unsigned numBytes, unsigned position)
   }
 
   unsigned fileLength = hdr->FileLength();
-  unsigned firstSector, lastSector, numSectors;
-  char *buf;
+  unsigned firstSector, lastSector;
 
   if (position >= fileLength)
   {
@@ -134,20 +137,36 @@ int OpenFile::ReadAt(char *into, unsigned numBytes, unsigned position)
 
   firstSector = DivRoundDown(position, SECTOR_SIZE);
   lastSector = DivRoundDown(position + numBytes - 1, SECTOR_SIZE);
-  numSectors = 1 + lastSector - firstSector;
 
-  // Read in all the full and partial sectors that we need.
-  buf = new char[numSectors * SECTOR_SIZE];
+  unsigned first = firstSector, last = lastSector;
+  unsigned head = position % SECTOR_SIZE;
+  unsigned tail = (position + numBytes) % SECTOR_SIZE;
+  char partial[SECTOR_SIZE];
 
-  for (unsigned i = firstSector; i <= lastSector; i++)
+  // Partial sectors at either end.
+  if (head != 0 || numBytes < SECTOR_SIZE)
+  {
+    unsigned size = SECTOR_SIZE - head < numBytes ? SECTOR_SIZE - head
+                                                  : numBytes;
+    ReadSectors(first, 1, partial);
+    memcpy(into, &partial[head], size);
+    first++;
+  }
+  if (tail != 0 && last >= first)
+  {
+    ReadSectors(last, 1, partial);
+    memcpy(&into[numBytes - tail], partial, tail);
+    last--;
+  }
+
+  // Whole sectors in between.
+  if (last + 1 > first)
   {
-    synchDisk->ReadSector(hdr->ByteToSector(i * SECTOR_SIZE),
-                          &buf[(i - firstSector) * SECTOR_SIZE]);
+    ReadSectors(first, last + 1 - first,
+                &into[first * SECTOR_SIZE - position]);
   }
 
-  // Copy the part we want.
-  memcpy(into, &buf[position - firstSector * SECTOR_SIZE], numBytes);
-  delete[] buf;
+  ReadAhead(firstSector, lastSector, fileLength);
 
   if (synchFile)
   {
@@ -168,9 +187,7 @@ int OpenFile::WriteAt(const char *from, unsigned numBytes, unsigned position)
   }
 
   unsigned fileLength = hdr->FileLength();
-  unsigned firstSector, lastSector, numSectors;
-  bool firstAligned, lastAligned;
-  char *buf;
+  unsigned firstSector, lastSector;
 
   if (position >= fileLength || position + numBytes > fileLength)
   {
@@ -179,6 +196,10 @@ int OpenFile::WriteAt(const char *from, unsigned numBytes, unsigned position)
     if (!fileSystem->Extend(position + numBytes, id))
     {
       DEBUG('f', "Error extending file.\n");
+      if (synchFile)
+      {
+        synchFile->DoneWrite();
+      }
       return 0;
     }
   }
@@ -188,41 +209,100 @@ int OpenFile::WriteAt(const char *from, unsigned numBytes, unsigned position)
 
   firstSector = DivRoundDown(position, SECTOR_SIZE);
   lastSector = DivRoundDown(position + numBytes - 1, SECTOR_SIZE);
-  numSectors = 1 + lastSector - firstSector;
 
-  buf = new char[numSectors * SECTOR_SIZE];
+  unsigned head = position % SECTOR_SIZE;
+  unsigned tail = (position + numBytes) % SECTOR_SIZE;
+  char partial[SECTOR_SIZE];
 
-  firstAligned = position == firstSector * SECTOR_SIZE;
-  lastAligned = position + numBytes == (lastSector + 1) * SECTOR_SIZE;
-
-  // Read in first and last sector, if they are to be partially modified.
-  if (!firstAligned)
+  for (unsigned i = firstSector; i <= lastSector; i++)
   {
-    ReadAt(buf, SECTOR_SIZE, firstSector * SECTOR_SIZE);
+    int sector = hdr->ByteToSector(i * SECTOR_SIZE);
+    bool whole = (i != firstSector || head == 0)
+                 && (i != lastSector || tail == 0);
+    if (whole)
+    {
+      blockCache->WriteSector(sector, &from[i * SECTOR_SIZE - position]);
+      continue;
+    }
+
+    // Only the bytes the file had before are worth reading; the rest
+    // reads as zeros.
+    unsigned kept = 0;
+    if (i * SECTOR_SIZE < fileLength)
+    {
+      blockCache->ReadSector(sector, partial);
+      kept = fileLength - i * SECTOR_SIZE;
+    }
+    if (kept < SECTOR_SIZE)
+      memset(&partial[kept], 0, SECTOR_SIZE - kept);
+    unsigned start = i == firstSector ? head : 0;
+    unsigned end = i == lastSector && tail != 0 ? tail : SECTOR_SIZE;
+    memcpy(&partial[start], &from[i * SECTOR_SIZE + start - position],
+           end - start);
+    blockCache->WriteSector(sector, partial);
   }
-  if (!lastAligned && (firstSector != lastSector || firstAligned))
+
+  if (synchFile)
   {
-    ReadAt(&buf[(lastSector - firstSector) * SECTOR_SIZE],
-           SECTOR_SIZE, lastSector * SECTOR_SIZE);
+    synchFile->DoneWrite();
   }
 
-  // Copy in the bytes we want to change.
-  memcpy(&buf[position - firstSector * SECTOR_SIZE], from, numBytes);
+  return numBytes;
+}
 
-  // Write modified sectors back.
-  for (unsigned i = firstSector; i <= lastSector; i++)
+/// Read `count` sectors of the file, starting at `first`, into `data`.
+/// Those not cached are read together, a batch of sectors at a time.
+void OpenFile::ReadSectors(unsigned first, unsigned count, char *data)
+{
+  for (unsigned i = 0; i < count; i += CACHE_BATCH)
   {
-    synchDisk->WriteSector(hdr->ByteToSector(i * SECTOR_SIZE),
-                           &buf[(i - firstSector) * SECTOR_SIZE]);
+    int sectors[CACHE_BATCH];
+    unsigned n = 0;
+    for (; n < CACHE_BATCH && i + n < count; n++)
+      sectors[n] = hdr->ByteToSector((first + i + n) * SECTOR_SIZE);
+    blockCache->ReadSectors(sectors, n, &data[i * SECTOR_SIZE]);
   }
-  delete[] buf;
+}
 
-  if (synchFile)
+/// Update the access pattern with a read of sectors `first` to `last` (file
+/// relative), and if it looks sequential, ask the cache for the sectors that
+/// come next.
+///
+/// The window starts at `READ_AHEAD_MIN` sectors and doubles every time the
+/// reader moves on to a new sector, up to `READ_AHEAD_MAX`.  A read
+/// anywhere else closes it.  New sectors are requested once half the window
+/// has been consumed, so that the disk gets them in runs.
+void OpenFile::ReadAhead(unsigned first, unsigned last, unsigned fileLength)
+{
+  if (first != nextSector && (nextSector == 0 || first != nextSector - 1))
   {
-    synchFile->DoneWrite();
+    // Not sequential, unless it continues within the same sector.
+    raWindow = 0;
+    raEnd = 0;
   }
-
-  return numBytes;
+  else if (last >= nextSector)
+  {
+    raWindow = raWindow == 0 ? READ_AHEAD_MIN : 2 * raWindow;
+    if (raWindow > READ_AHEAD_MAX)
+      raWindow = READ_AHEAD_MAX;
+  }
+  nextSector = last + 1;
+  if (raWindow == 0)
+    return;
+
+  if (raEnd < nextSector)
+    raEnd = nextSector;
+  if (raEnd - nextSector > raWindow / 2)
+    return;
+  unsigned end = nextSector + raWindow;
+  unsigned numSectors = DivRoundUp(fileLength, SECTOR_SIZE);
+  if (end > numSectors)
+    end = numSectors;
+  int sectors[READ_AHEAD_MAX];
+  unsigned n = 0;
+  for (; raEnd < end; raEnd++)
+    sectors[n++] = hdr->ByteToSector(raEnd * SECTOR_SIZE);
+  blockCache->Prefetch(sectors, n);
 }
 
 /// Return the number of bytes in the file.
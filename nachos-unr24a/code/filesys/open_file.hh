@@ -83,6 +83,11 @@ private:
 };
 
 #else // FILESYS
+
+/// Bounds of the read-ahead window, in sectors.
+const unsigned READ_AHEAD_MIN = 2;
+const unsigned READ_AHEAD_MAX = 16;
+
 class FileHeader;
 class SynchFile;
 class OpenFile
@@ -122,6 +127,15 @@ private:
   unsigned seekPosition; ///< Current position within the file.
   SynchFile *synchFile;
   unsigned id;
+
+  /// Sequential access detection.
+  unsigned nextSector; ///< Sector a sequential read would start at.
+  unsigned raWindow;   ///< Sectors to read ahead, 0 if access is random.
+  unsigned raEnd;      ///< First sector not requested ahead yet.
+
+  void ReadAhead(unsigned firstSector, unsigned lastSector,
+                 unsigned fileLength);
+  void ReadSectors(unsigned first, unsigned count, char *data);
 };
 
 #endif
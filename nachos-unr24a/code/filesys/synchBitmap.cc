@@ -1,6 +1,6 @@
 #include "synchBitmap.hh"
-#include "threads/lock.hh"
-SynchBitmap::SynchBitmap(unsigned nitems, Lock *l)
+#include "threads/rw_lock.hh"
+SynchBitmap::SynchBitmap(unsigned nitems, RWLock *l)
 {
   lock = l;
   bitmap = new Bitmap(nitems);
@@ -40,26 +40,37 @@ void SynchBitmap::Print() const
   bitmap->Print();
 }
 
-void SynchBitmap::FetchFrom(OpenFile *file)
+void SynchBitmap::Load(OpenFile *file)
 {
-  lock->Acquire();
+  lock->AcquireWrite();
   bitmap->FetchFrom(file);
+  lock->ReleaseWrite();
 }
 
-void SynchBitmap::WriteBack(OpenFile *file) const
+void SynchBitmap::WriteBack(OpenFile *file)
 {
-  bitmap->WriteBack(file);
-  lock->Release();
+  bitmap->WriteDirty(file);
+  lock->ReleaseWrite();
 }
 
 void SynchBitmap::Request()
 {
-  lock->Acquire();
+  lock->AcquireWrite();
 }
 
 void SynchBitmap::Flush()
 {
-  lock->Release();
+  lock->ReleaseWrite();
+}
+
+void SynchBitmap::StartRead()
+{
+  lock->AcquireRead();
+}
+
+void SynchBitmap::DoneRead()
+{
+  lock->ReleaseRead();
 }
 
 Bitmap *SynchBitmap::GetBitmap()
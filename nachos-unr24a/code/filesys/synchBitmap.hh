@@ -3,11 +3,18 @@
 
 #include "lib/bitmap.hh"
 
-class Lock;
+class RWLock;
+
+/// The free map, kept in memory for as long as the file system is mounted.
+///
+/// `Request` ... `WriteBack`/`Flush` hold the free map lock exclusively,
+/// `StartRead` ... `DoneRead` share it with other readers.  `WriteBack`
+/// only writes the words that changed; `Flush` writes nothing, so the
+/// caller must have undone its changes.
 class SynchBitmap
 {
 public:
-  SynchBitmap(unsigned nitems, Lock *l);
+  SynchBitmap(unsigned nitems, RWLock *l);
   ~SynchBitmap();
   void Mark(unsigned which);
   void Clear(unsigned which);
@@ -16,17 +23,21 @@ public:
   unsigned CountClear() const;
   void Print() const;
 
-  void FetchFrom(OpenFile *file);
-  void WriteBack(OpenFile *file) const;
+  /// Read the map from `file`, when mounting the file system.
+  void Load(OpenFile *file);
 
   void Request();
+  void WriteBack(OpenFile *file);
   void Flush();
 
+  void StartRead();
+  void DoneRead();
+
   Bitmap *GetBitmap();
 
 private:
   Bitmap *bitmap;
-  Lock *lock;
+  RWLock *lock;
 };
 
 #endif
\ No newline at end of file
@@ -1,12 +1,14 @@
 #include "synchDirectory.hh"
-#include "threads/lock.hh"
-SynchDirectory::SynchDirectory(unsigned size, Lock *l, unsigned currentSector, unsigned parentSector)
+#include "threads/rw_lock.hh"
+#include "threads/system.hh"
+SynchDirectory::SynchDirectory(unsigned size, RWLock *l, unsigned currentSector, unsigned parentSector)
 {
   ASSERT(l != nullptr);
   lock = l;
   DEBUG('f', "synchDirectory %p\n", lock);
   directory = new Directory(size, currentSector, parentSector);
   loop = 0;
+  fresh = false;
 }
 SynchDirectory::~SynchDirectory()
 {
@@ -18,21 +20,26 @@ void SynchDirectory::FetchFrom(OpenFile *file)
   // if (!lock)
   //   DEBUG('f', "Lock is null\n");
 
-  if (!lock->IsHeldByCurrentThread())
+  if (!lock->IsWriteHeldByCurrentThread())
   {
     // DEBUG('f', "Fetching directory from file PreAcq\n");
-    lock->Acquire();
+    lock->AcquireWrite();
   }
   // DEBUG('f', "Fetching directory from file, its held\n");
   loop++;
-  directory->FetchFrom(file);
+  if (!fresh)
+  {
+    directory->FetchFrom(file);
+    fresh = true;
+  }
 }
 void SynchDirectory::WriteBack(OpenFile *file)
 {
   directory->WriteBack(file);
+  fresh = true;
   loop--;
   if (loop == 0)
-    lock->Release();
+    lock->ReleaseWrite();
 }
 int SynchDirectory::Find(const char *name)
 {
@@ -40,10 +47,17 @@ int SynchDirectory::Find(const char *name)
 }
 bool SynchDirectory::Add(const char *name, int newSector, bool isDir)
 {
+  ASSERT(lock->IsWriteHeldByCurrentThread());
+  nameCache->Forget(directory->GetSector(), name);
   return directory->Add(name, newSector, isDir);
 }
 bool SynchDirectory::Remove(const char *name)
 {
+  ASSERT(lock->IsWriteHeldByCurrentThread());
+  nameCache->Forget(directory->GetSector(), name);
+  int sector = directory->Find(name);
+  if (sector != -1 && directory->IsDir(name))
+    nameCache->Purge(sector);
   return directory->Remove(name);
 }
 void SynchDirectory::List() const
@@ -61,16 +75,45 @@ const RawDirectory *SynchDirectory::GetRaw() const
 
 void SynchDirectory::Request()
 {
-  if (!lock->IsHeldByCurrentThread())
-    lock->Acquire();
+  if (!lock->IsWriteHeldByCurrentThread())
+    lock->AcquireWrite();
   loop++;
 }
 
 void SynchDirectory::Flush()
 {
+  // The update was abandoned, so the copy in memory may have been changed
+  // without being written.
+  fresh = false;
   loop--;
   if (loop == 0)
-    lock->Release();
+    lock->ReleaseWrite();
+}
+
+void SynchDirectory::StartLookup(OpenFile *file)
+{
+  lock->AcquireRead();
+  if (fresh || lock->IsWriteHeldByCurrentThread())
+    return;
+
+  // Someone has to bring the directory in, and that needs the lock for
+  // writing.
+  if (!lock->TryUpgrade())
+  {
+    lock->ReleaseRead();
+    lock->AcquireWrite();
+  }
+  if (!fresh)
+  {
+    directory->FetchFrom(file);
+    fresh = true;
+  }
+  lock->Downgrade();
+}
+
+void SynchDirectory::DoneLookup()
+{
+  lock->ReleaseRead();
 }
 
 bool SynchDirectory::IsDir(const char *name)
@@ -81,4 +124,9 @@ bool SynchDirectory::IsDir(const char *name)
 unsigned SynchDirectory::GetParentSector()
 {
   return directory->GetParentSector();
+}
+
+unsigned SynchDirectory::GetSector()
+{
+  return directory->GetSector();
 }
\ No newline at end of file
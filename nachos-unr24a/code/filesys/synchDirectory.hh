@@ -2,11 +2,20 @@
 #define NACHOS_FILESYS_SYNCHDIRECTORY_HH
 
 #include "directory.hh"
-class Lock;
+class RWLock;
+
+/// A directory shared by every thread that uses it.
+///
+/// Updates (`FetchFrom` ... `WriteBack`/`Flush`) hold the lock exclusively,
+/// while lookups (`StartLookup` ... `DoneLookup`) share it.  Both work on
+/// the copy kept in memory, fetching it only when it is not known to match
+/// the disk, which happens only after an update is abandoned.
+///
+/// Names that an update touches are forgotten by the name cache.
 class SynchDirectory
 {
 public:
-  SynchDirectory(unsigned size, Lock *l, unsigned currentSector, unsigned parentSector);
+  SynchDirectory(unsigned size, RWLock *l, unsigned currentSector, unsigned parentSector);
   ~SynchDirectory();
   void FetchFrom(OpenFile *file);
   void WriteBack(OpenFile *file);
@@ -19,14 +28,19 @@ public:
   void Request();
   void Flush();
 
+  void StartLookup(OpenFile *file);
+  void DoneLookup();
+
   bool IsDir(const char *name);
   unsigned GetParentSector();
+  unsigned GetSector();
 
-  Lock *lock;
+  RWLock *lock;
 
 private:
   Directory *directory;
   unsigned loop;
+  bool fresh; ///< The copy in memory matches the one on disk.
 };
 
 #endif
\ No newline at end of file
@@ -1,60 +1,34 @@
 #include "synchFile.hh"
-#include "threads/condition.hh"
+#include "threads/rw_lock.hh"
+#include "threads/system.hh"
 
 SynchFile::SynchFile()
 {
-  lock = new Lock("synch file lock");
-  cond = new Condition("synch file cond", lock);
-  writer = nullptr;
-  numWritersWaiting = 0;
-  numReadersActive = 0;
+  rwLock = new RWLock("synch file lock");
 }
 SynchFile::~SynchFile()
 {
-  delete lock;
-  delete cond;
+  delete rwLock;
 }
 
 void SynchFile::StartRead(Thread *t)
 {
-  lock->Acquire();
-  if (t != writer)
-    while (writer != nullptr || numWritersWaiting > 0)
-    {
-      cond->Wait();
-    }
-  numReadersActive++;
-  lock->Release();
+  ASSERT(t == currentThread);
+  rwLock->AcquireRead();
 }
 
 void SynchFile::DoneRead()
 {
-  lock->Acquire();
-  numReadersActive--;
-  if (numReadersActive == 0)
-  {
-    cond->Broadcast();
-  }
-  lock->Release();
+  rwLock->ReleaseRead();
 }
 
 void SynchFile::StartWrite(Thread *t)
 {
-  lock->Acquire();
-  numWritersWaiting++;
-  while (writer != nullptr || numReadersActive > 0)
-  {
-    cond->Wait();
-  }
-  numWritersWaiting--;
-  writer = t;
-  lock->Release();
+  ASSERT(t == currentThread);
+  rwLock->AcquireWrite();
 }
 
 void SynchFile::DoneWrite()
 {
-  lock->Acquire();
-  writer = nullptr;
-  cond->Broadcast();
-  lock->Release();
-}
\ No newline at end of file
+  rwLock->ReleaseWrite();
+}
@@ -1,10 +1,12 @@
 #ifndef NACHOS_FILESYS_SYNCHFILE__HH
 #define NACHOS_FILESYS_SYNCHFILE__HH
 
-class Condition;
-class Lock;
+class RWLock;
 class Thread;
 
+/// Readers/writers access to the contents of an open file.
+///
+/// The writer may also read (`WriteAt` reads partial sectors back).
 class SynchFile
 {
 public:
@@ -16,10 +18,7 @@ public:
   void DoneWrite();
 
 private:
-  Lock *lock;
-  Condition *cond;
-  unsigned numReadersActive, numWritersWaiting;
-  Thread *writer;
+  RWLock *rwLock;
 };
 
-#endif
\ No newline at end of file
+#endif
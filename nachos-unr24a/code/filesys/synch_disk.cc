@@ -3,9 +3,14 @@
 /// happens later on).  This is a layer on top of the disk providing a
 /// synchronous interface (requests wait until the request completes).
 ///
-/// Use a semaphore to synchronize the interrupt handlers with the pending
-/// requests.  And, because the physical disk can only handle one operation
-/// at a time, use a lock to enforce mutual exclusion.
+/// Each request carries a semaphore to synchronize the interrupt handler
+/// with the thread waiting for it.  Because the physical disk can only
+/// handle one operation at a time, requests are queued, and whenever the
+/// disk becomes free the next one is chosen in C-LOOK order: the nearest
+/// sector at or after the head, wrapping around to the lowest one.  This
+/// sweeps the arm across the disk in a single direction instead of
+/// following arrival order.  A request that has waited `DISK_DEADLINE`
+/// ticks is served next regardless of where it is.
 ///
 /// Copyright (c) 1992-1993 The Regents of the University of California.
 ///               2016-2021 Docentes de la Universidad Nacional de Rosario.
@@ -14,6 +19,7 @@
 
 
 #include "synch_disk.hh"
+#include "threads/system.hh"
 
 
 /// Disk interrupt handler.  Need this to be a C routine, because C++ cannot
@@ -31,19 +37,21 @@ DiskRequestDone(void *arg)
 ///
 /// * `name` is a UNIX file name to be used as storage for the disk data
 ///   (usually, `DISK`).
-SynchDisk::SynchDisk(const char *name)
+/// * `sectorsPerTrack`, `numTracks` and `mode` are passed to the `Disk`.
+SynchDisk::SynchDisk(const char *name, unsigned sectorsPerTrack,
+                     unsigned numTracks, DiskMode mode)
 {
-    semaphore = new Semaphore("synch disk", 0);
-    lock = new Lock("synch disk lock");
-    disk = new Disk(name, DiskRequestDone, this);
+    pending = nullptr;
+    active = nullptr;
+    headSector = 0;
+    disk = new Disk(name, sectorsPerTrack, numTracks, mode,
+                    DiskRequestDone, this);
 }
 
 /// De-allocate data structures needed for the synchronous disk abstraction.
 SynchDisk::~SynchDisk()
 {
     delete disk;
-    delete lock;
-    delete semaphore;
 }
 
 /// Read the contents of a disk sector into a buffer.  Return only after the
@@ -54,12 +62,7 @@ SynchDisk::~SynchDisk()
 void
 SynchDisk::ReadSector(int sectorNumber, char *data)
 {
-    ASSERT(data != nullptr);
-
-    lock->Acquire();  // Only one disk I/O at a time.
-    disk->ReadRequest(sectorNumber, data);
-    semaphore->P();   // Wait for interrupt.
-    lock->Release();
+    ReadSectors(sectorNumber, 1, data);
 }
 
 /// Write the contents of a buffer into a disk sector.  Return only
@@ -69,19 +72,204 @@ SynchDisk::ReadSector(int sectorNumber, char *data)
 /// * `data` are the new contents of the disk sector.
 void
 SynchDisk::WriteSector(int sectorNumber, const char *data)
+{
+    WriteSectors(sectorNumber, 1, data);
+}
+
+/// Transfers longer than the disk takes at once are split in several
+/// requests, queued one after the other.
+void
+SynchDisk::ReadSectors(int firstSector, unsigned count, char *data)
 {
     ASSERT(data != nullptr);
 
-    lock->Acquire();  // only one disk I/O at a time
-    disk->WriteRequest(sectorNumber, data);
-    semaphore->P();   // wait for interrupt
-    lock->Release();
+    for (unsigned i = 0; i < count; i += MAX_REQUEST_SECTORS) {
+        unsigned n = count - i < MAX_REQUEST_SECTORS
+                     ? count - i : MAX_REQUEST_SECTORS;
+        DiskRequest request = { firstSector + (int) i, n, nullptr, false,
+                                &data[i * SECTOR_SIZE], nullptr, 0, nullptr,
+                                nullptr };
+        Perform(&request);
+    }
+}
+
+void
+SynchDisk::WriteSectors(int firstSector, unsigned count, const char *data)
+{
+    ASSERT(data != nullptr);
+
+    for (unsigned i = 0; i < count; i += MAX_REQUEST_SECTORS) {
+        unsigned n = count - i < MAX_REQUEST_SECTORS
+                     ? count - i : MAX_REQUEST_SECTORS;
+        DiskRequest request = { firstSector + (int) i, n, nullptr, true,
+                                (char *) &data[i * SECTOR_SIZE], nullptr, 0,
+                                nullptr, nullptr };
+        Perform(&request);
+    }
+}
+
+void
+SynchDisk::ReadSectors(const int *sectors, unsigned count, char *const *data)
+{
+    ASSERT(sectors != nullptr && data != nullptr);
+
+    for (unsigned i = 0; i < count; i += MAX_REQUEST_SECTORS) {
+        unsigned n = count - i < MAX_REQUEST_SECTORS
+                     ? count - i : MAX_REQUEST_SECTORS;
+        DiskRequest request = { sectors[i], n, &sectors[i], false, nullptr,
+                                &data[i], 0, nullptr, nullptr };
+        Perform(&request);
+    }
+}
+
+void
+SynchDisk::WriteSectors(const int *sectors, unsigned count,
+                        const char *const *data)
+{
+    ASSERT(sectors != nullptr && data != nullptr);
+
+    for (unsigned i = 0; i < count; i += MAX_REQUEST_SECTORS) {
+        unsigned n = count - i < MAX_REQUEST_SECTORS
+                     ? count - i : MAX_REQUEST_SECTORS;
+        DiskRequest request = { sectors[i], n, &sectors[i], true, nullptr,
+                                (char *const *) &data[i], 0, nullptr,
+                                nullptr };
+        Perform(&request);
+    }
+}
+
+void
+SynchDisk::Perform(DiskRequest *request)
+{
+    Semaphore done(request->writing ? "synch disk write" : "synch disk read",
+                   0);
+    request->done = &done;
+    Enqueue(request);
+    done.P();  // Wait for interrupt.
 }
 
-/// Disk interrupt handler.  Wake up any thread waiting for the disk
-/// request to finish.
+/// Disk interrupt handler.  Wake up the thread waiting for the request to
+/// finish, and start the next one.
 void
 SynchDisk::RequestDone()
 {
-    semaphore->V();
+    ASSERT(active != nullptr);
+
+    Semaphore *done = active->done;
+    active = nullptr;
+    Dispatch();
+    done->V();
+}
+
+/// Only to be called while the disk is idle, since queued requests were
+/// checked against the old geometry.
+void
+SynchDisk::SetGeometry(unsigned sectorsPerTrack, unsigned numTracks)
+{
+    ASSERT(pending == nullptr && active == nullptr);
+    disk->SetGeometry(sectorsPerTrack, numTracks);
+}
+
+unsigned
+SynchDisk::GetSectorsPerTrack() const
+{
+    return disk->GetSectorsPerTrack();
+}
+
+unsigned
+SynchDisk::GetNumSectors() const
+{
+    return disk->GetNumSectors();
+}
+
+/// Add `request` to the queue, and send it to the disk right away if the
+/// disk is idle.
+void
+SynchDisk::Enqueue(DiskRequest *request)
+{
+    ASSERT(request->count > 0);
+    for (unsigned i = 0; i < request->count; i++) {
+        int sector = request->sectors != nullptr
+                     ? request->sectors[i] : request->sector + (int) i;
+        ASSERT(0 <= sector && (unsigned) sector < disk->GetNumSectors());
+    }
+
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+    request->deadline = stats->totalTicks + DISK_DEADLINE;
+    request->next = nullptr;
+    DiskRequest **p = &pending;
+    while (*p != nullptr) {
+        p = &(*p)->next;
+    }
+    *p = request;
+    if (active == nullptr) {
+        Dispatch();
+    }
+    interrupt->SetLevel(oldLevel);
+}
+
+/// Remove the next request to serve from the queue.  Must be called with
+/// interrupts disabled.
+DiskRequest *
+SynchDisk::PickNext()
+{
+    DiskRequest **best = nullptr;
+
+    // The queue is in arrival order, so the first expired request is the
+    // one that has waited the longest.
+    if (pending->deadline <= stats->totalTicks) {
+        best = &pending;
+    } else {
+        DiskRequest **lowest = &pending;
+        for (DiskRequest **p = &pending; *p != nullptr; p = &(*p)->next) {
+            int sector = (*p)->sector;
+            if (sector < (*lowest)->sector) {
+                lowest = p;
+            }
+            if (sector >= headSector
+                  && (best == nullptr || sector < (*best)->sector)) {
+                best = p;
+            }
+        }
+        if (best == nullptr) {  // Nothing ahead of the head: wrap around.
+            best = lowest;
+        }
+    }
+
+    DiskRequest *request = *best;
+    *best = request->next;
+    return request;
+}
+
+/// Send the next pending request, if any, to the disk.  Must be called with
+/// interrupts disabled and the disk idle.
+void
+SynchDisk::Dispatch()
+{
+    ASSERT(interrupt->GetLevel() == INT_OFF);
+    ASSERT(active == nullptr);
+
+    if (pending == nullptr) {
+        return;
+    }
+    active = PickNext();
+    DEBUG('d', "Dispatching %s of %u sectors from sector %d\n",
+          active->writing ? "write" : "read", active->count, active->sector);
+    unsigned last = active->count - 1;
+    if (active->sectors != nullptr) {
+        const unsigned *sectors = (const unsigned *) active->sectors;
+        headSector = active->sectors[last];
+        if (active->writing) {
+            disk->WriteRequest(sectors, active->buffers, active->count);
+        } else {
+            disk->ReadRequest(sectors, active->buffers, active->count);
+        }
+    } else {
+        headSector = active->sector + (int) last;
+        if (active->writing) {
+            disk->WriteRequest(active->sector, active->count, active->data);
+        } else {
+            disk->ReadRequest(active->sector, active->count, active->data);
+        }
+    }
 }
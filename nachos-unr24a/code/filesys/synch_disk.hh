@@ -10,10 +10,30 @@
 
 
 #include "machine/disk.hh"
-#include "threads/lock.hh"
 #include "threads/semaphore.hh"
 
 
+/// A request that has not been sent to the disk yet is served anyway once
+/// it has waited this many ticks, even if it is out of the way of the head.
+const unsigned long DISK_DEADLINE = 100000;
+
+/// A pending read or write.  Lives in the stack of the requesting thread.
+///
+/// It covers `count` sectors: either consecutive ones from `sector` on, to
+/// or from `data`, or, if `sectors` is given, `sectors[i]` to or from
+/// `buffers[i]` (and `sector` is the first of them).
+struct DiskRequest {
+    int sector;
+    unsigned count;
+    const int *sectors;
+    bool writing;
+    char *data;
+    char *const *buffers;
+    unsigned long deadline;  ///< Tick after which it is served first.
+    Semaphore *done;         ///< Signalled by the interrupt handler.
+    DiskRequest *next;
+};
+
 /// The following class defines a "synchronous" disk abstraction.
 ///
 /// As with other I/O devices, the raw physical disk is an asynchronous
@@ -24,32 +44,63 @@
 ///
 /// This class provides the abstraction that for any individual thread making
 /// a request, it waits around until the operation finishes before returning.
+/// Requests from different threads are queued and reordered to shorten
+/// seeks.
 class SynchDisk {
 public:
 
     /// Initialize a synchronous disk, by initializing the raw Disk.
-    SynchDisk(const char *name);
+    SynchDisk(const char *name,
+              unsigned sectorsPerTrack = DEFAULT_SECTORS_PER_TRACK,
+              unsigned numTracks = DEFAULT_NUM_TRACKS,
+              DiskMode mode = DISK_MAPPED);
 
     /// De-allocate the synch disk data.
     ~SynchDisk();
 
     /// Read/write a disk sector, returning only once the data is actually
-    /// read or written.  These call `Disk::ReadRequest`/`WriteRequest` and
-    /// then wait until the request is done.
+    /// read or written.  These queue a request and wait until it is done;
+    /// several threads may have requests queued at once.
 
     void ReadSector(int sectorNumber, char *data);
     void WriteSector(int sectorNumber, const char *data);
 
+    /// Read/write `count` consecutive sectors starting at `firstSector`,
+    /// from/to `count * SECTOR_SIZE` bytes at `data`.
+    void ReadSectors(int firstSector, unsigned count, char *data);
+    void WriteSectors(int firstSector, unsigned count, const char *data);
+
+    /// Read/write `sectors[i]` from/to `data[i]`, for `i` below `count`.
+    /// Cheapest when the sectors are in ascending order.
+    void ReadSectors(const int *sectors, unsigned count, char *const *data);
+    void WriteSectors(const int *sectors, unsigned count,
+                      const char *const *data);
+
     /// Called by the disk device interrupt handler, to signal that the
     /// current disk operation is complete.
     void RequestDone();
 
+    /// Geometry of the disk, see `Disk`.
+    void SetGeometry(unsigned sectorsPerTrack, unsigned numTracks);
+    unsigned GetSectorsPerTrack() const;
+    unsigned GetNumSectors() const;
+
 private:
     Disk *disk;  ///< Raw disk device.
-    Semaphore *semaphore;  ///< To synchronize requesting thread with the
-                           ///< interrupt handler.
-    Lock *lock;  ///< Only one read/write request can be sent to the disk at
-                 ///< a time.
+
+    /// Requests waiting for the disk, in arrival order.  Protected by
+    /// disabling interrupts, since the interrupt handler starts the next
+    /// one.
+    DiskRequest *pending;
+    DiskRequest *active;  ///< Request the disk is working on, if any.
+    int headSector;       ///< Last sector of the request sent to the disk.
+
+    /// Queue `request` and wait until it is done.
+    void Perform(DiskRequest *request);
+
+    void Enqueue(DiskRequest *request);
+    DiskRequest *PickNext();
+    void Dispatch();
 };
 
 
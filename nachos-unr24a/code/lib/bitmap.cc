@@ -10,6 +10,14 @@
 
 #include <stdio.h>
 
+/// Index of the lowest set bit of a non-zero word.
+static inline unsigned
+CountTrailingZeros(unsigned word)
+{
+  ASSERT(word != 0);
+  return __builtin_ctz(word);
+}
+
 /// Initialize a bitmap with `nitems` bits, so that every bit is clear.  It
 /// can be added somewhere on a list.
 ///
@@ -24,9 +32,19 @@ Bitmap::Bitmap(unsigned nitems)
 #ifdef SWAP
   coremapEntries = new Coremap[nitems];
 #endif
-  for (unsigned i = 0; i < numBits; i++)
+  fullWords = numWords >= BITS_IN_WORD
+                  ? new unsigned[DivRoundUp(numWords, BITS_IN_WORD)]
+                  : nullptr;
+  dirtyWords = new unsigned[DivRoundUp(numWords, BITS_IN_WORD)];
+  for (unsigned i = 0; i < numWords; i++)
   {
-    Clear(i);
+    map[i] = 0;
+  }
+  Recount();
+  // Nothing has been written yet.
+  for (unsigned s = 0; s < DivRoundUp(numWords, BITS_IN_WORD); s++)
+  {
+    dirtyWords[s] = ~0u;
   }
 }
 
@@ -34,6 +52,8 @@ Bitmap::Bitmap(unsigned nitems)
 Bitmap::~Bitmap()
 {
   delete[] map;
+  delete[] fullWords;
+  delete[] dirtyWords;
 #ifdef SWAP
   delete[] coremapEntries;
 #endif
@@ -45,7 +65,15 @@ Bitmap::~Bitmap()
 void Bitmap::Mark(unsigned which)
 {
   ASSERT(which < numBits);
-  map[which / BITS_IN_WORD] |= 1 << which % BITS_IN_WORD;
+  unsigned word = which / BITS_IN_WORD;
+  unsigned bit = 1u << which % BITS_IN_WORD;
+  if (map[word] & bit)
+  {
+    return;
+  }
+  map[word] |= bit;
+  numClear--;
+  WordChanged(word);
 }
 
 /// Clear the “nth” bit in a bitmap.
@@ -54,7 +82,19 @@ void Bitmap::Mark(unsigned which)
 void Bitmap::Clear(unsigned which)
 {
   ASSERT(which < numBits);
-  map[which / BITS_IN_WORD] &= ~(1 << which % BITS_IN_WORD);
+  unsigned word = which / BITS_IN_WORD;
+  unsigned bit = 1u << which % BITS_IN_WORD;
+  if (!(map[word] & bit))
+  {
+    return;
+  }
+  map[word] &= ~bit;
+  numClear++;
+  WordChanged(word);
+  if (which < firstClearHint)
+  {
+    firstClearHint = which;
+  }
 }
 
 /// Return true if the “nth” bit is set.
@@ -63,7 +103,7 @@ void Bitmap::Clear(unsigned which)
 bool Bitmap::Test(unsigned which) const
 {
   ASSERT(which < numBits);
-  return map[which / BITS_IN_WORD] & 1 << which % BITS_IN_WORD;
+  return map[which / BITS_IN_WORD] & 1u << which % BITS_IN_WORD;
 }
 
 /// Return the number of the first bit which is clear.  As a side effect, set
@@ -72,13 +112,82 @@ bool Bitmap::Test(unsigned which) const
 /// If no bits are clear, return -1.
 int Bitmap::Find()
 {
-  for (unsigned i = 0; i < numBits; i++)
+  int i = NextClear(firstClearHint);
+  if (i == -1)
+  {
+    firstClearHint = numBits;
+    return -1;
+  }
+  Mark(i);
+  firstClearHint = i + 1;
+  return i;
+}
+
+/// Return the number of the first clear bit at or after `start`, wrapping
+/// around to the beginning of the bitmap.  As a side effect, set the bit.
+///
+/// If no bits are clear, return -1.
+///
+/// * `start` is where to begin looking.
+int Bitmap::FindFrom(unsigned start)
+{
+  ASSERT(start < numBits);
+  int i = NextClear(start);
+  if (i == -1)
+  {
+    i = NextClear(firstClearHint);
+  }
+  if (i != -1)
+  {
+    Mark(i);
+  }
+  return i;
+}
+
+/// Find a run of `n` clear bits beginning at `start` or later, set them and
+/// return the first one.
+///
+/// If no such run exists, return -1 and leave the bitmap untouched.
+///
+/// * `n` is the length of the run.
+/// * `start` is where to begin looking.
+/// * `boundary`, if not 0, keeps runs of up to that length from spanning a
+///   multiple of it (for instance, a disk track).
+int Bitmap::FindContiguous(unsigned n, unsigned start, unsigned boundary)
+{
+  ASSERT(n > 0);
+  if (boundary != 0 && n > boundary)
+  {
+    boundary = 0; // Cannot be avoided.
+  }
+  if (n > numClear)
+  {
+    return -1;
+  }
+
+  for (unsigned i = start; i < numBits;)
   {
-    if (!Test(i))
+    int first = NextClear(i);
+    if (first == -1 || first + n > numBits)
+    {
+      return -1;
+    }
+    if (boundary != 0)
     {
-      Mark(i);
-      return i;
+      unsigned next = (first / boundary + 1) * boundary;
+      if (first + n > next)
+      {
+        i = next; // Every later start in this stretch straddles too.
+        continue;
+      }
     }
+    unsigned end = NextSet(first);
+    if (end >= first + n)
+    {
+      MarkRange(first, n);
+      return first;
+    }
+    i = end;
   }
   return -1;
 }
@@ -88,16 +197,151 @@ int Bitmap::Find()
 unsigned
 Bitmap::CountClear() const
 {
-  unsigned count = 0;
+  return numClear;
+}
 
-  for (unsigned i = 0; i < numBits; i++)
+unsigned
+Bitmap::GetNumBits() const
+{
+  return numBits;
+}
+
+int Bitmap::NextClear(unsigned start) const
+{
+  if (start >= numBits)
+  {
+    return -1;
+  }
+  unsigned word = start / BITS_IN_WORD;
+  unsigned clear = ~map[word] & ~0u << start % BITS_IN_WORD;
+  while (clear == 0)
+  {
+    if ((word = NextNonFullWord(word + 1)) >= numWords)
+    {
+      return -1;
+    }
+    clear = ~map[word];
+  }
+  return word * BITS_IN_WORD + CountTrailingZeros(clear);
+}
+
+unsigned Bitmap::NextSet(unsigned start) const
+{
+  if (start >= numBits)
   {
-    if (!Test(i))
+    return numBits;
+  }
+  unsigned word = start / BITS_IN_WORD;
+  unsigned set = map[word] & ~0u << start % BITS_IN_WORD;
+  while (set == 0)
+  {
+    if (++word >= numWords)
     {
-      count++;
+      return numBits;
+    }
+    set = map[word];
+  }
+  unsigned i = word * BITS_IN_WORD + CountTrailingZeros(set);
+  return i < numBits ? i : numBits;
+}
+
+unsigned Bitmap::NextNonFullWord(unsigned word) const
+{
+  if (fullWords == nullptr)
+  {
+    while (word < numWords && map[word] == ~0u)
+    {
+      word++;
+    }
+    return word;
+  }
+  while (word < numWords)
+  {
+    unsigned s = word / BITS_IN_WORD;
+    unsigned notFull = ~fullWords[s] & ~0u << word % BITS_IN_WORD;
+    if (notFull != 0)
+    {
+      return s * BITS_IN_WORD + CountTrailingZeros(notFull);
+    }
+    word = (s + 1) * BITS_IN_WORD;
+  }
+  return numWords;
+}
+
+void Bitmap::MarkRange(unsigned first, unsigned n)
+{
+  ASSERT(first + n <= numBits);
+  while (n > 0)
+  {
+    unsigned word = first / BITS_IN_WORD;
+    unsigned offset = first % BITS_IN_WORD;
+    unsigned count = BITS_IN_WORD - offset < n ? BITS_IN_WORD - offset : n;
+    unsigned mask = count == BITS_IN_WORD ? ~0u : ((1u << count) - 1) << offset;
+    ASSERT((map[word] & mask) == 0);
+    map[word] |= mask;
+    WordChanged(word);
+    numClear -= count;
+    first += count;
+    n -= count;
+  }
+}
+
+void Bitmap::WordChanged(unsigned word)
+{
+  dirtyWords[word / BITS_IN_WORD] |= 1u << word % BITS_IN_WORD;
+  UpdateSummary(word);
+}
+
+void Bitmap::UpdateSummary(unsigned word)
+{
+  if (fullWords == nullptr)
+  {
+    return;
+  }
+  unsigned bit = 1u << word % BITS_IN_WORD;
+  if (map[word] == ~0u)
+  {
+    fullWords[word / BITS_IN_WORD] |= bit;
+  }
+  else
+  {
+    fullWords[word / BITS_IN_WORD] &= ~bit;
+  }
+}
+
+void Bitmap::Recount()
+{
+  if (numBits % BITS_IN_WORD != 0)
+  {
+    map[numWords - 1] |= ~0u << numBits % BITS_IN_WORD;
+  }
+  numClear = 0;
+  for (unsigned i = 0; i < numWords; i++)
+  {
+    numClear += BITS_IN_WORD - __builtin_popcount(map[i]);
+  }
+  firstClearHint = 0;
+  for (unsigned s = 0; s < DivRoundUp(numWords, BITS_IN_WORD); s++)
+  {
+    dirtyWords[s] = 0;
+  }
+  if (fullWords != nullptr)
+  {
+    unsigned numSummaryWords = DivRoundUp(numWords, BITS_IN_WORD);
+    for (unsigned s = 0; s < numSummaryWords; s++)
+    {
+      fullWords[s] = 0;
+    }
+    // Words past the end count as full.
+    if (numWords % BITS_IN_WORD != 0)
+    {
+      fullWords[numSummaryWords - 1] = ~0u << numWords % BITS_IN_WORD;
+    }
+    for (unsigned i = 0; i < numWords; i++)
+    {
+      UpdateSummary(i);
     }
   }
-  return count;
 }
 
 /// Print the contents of the bitmap, for debugging.
@@ -126,6 +370,7 @@ void Bitmap::FetchFrom(OpenFile *file)
 {
   ASSERT(file != nullptr);
   file->ReadAt((char *)map, numWords * sizeof(unsigned), 0);
+  Recount();
 }
 
 /// Store the contents of a bitmap to a Nachos file.
@@ -137,4 +382,28 @@ void Bitmap::WriteBack(OpenFile *file) const
 {
   ASSERT(file != nullptr);
   file->WriteAt((char *)map, numWords * sizeof(unsigned), 0);
-}
\ No newline at end of file
+}
+
+/// Store the words changed since the bitmap was last read or written, each
+/// run of consecutive dirty words with a single write.
+///
+/// * `file` is the place to write the bitmap to.
+void Bitmap::WriteDirty(OpenFile *file)
+{
+  ASSERT(file != nullptr);
+  for (unsigned i = 0; i < numWords;)
+  {
+    if (!(dirtyWords[i / BITS_IN_WORD] & 1u << i % BITS_IN_WORD))
+    {
+      i++;
+      continue;
+    }
+    unsigned first = i;
+    for (; i < numWords && dirtyWords[i / BITS_IN_WORD] & 1u << i % BITS_IN_WORD; i++)
+    {
+      dirtyWords[i / BITS_IN_WORD] &= ~(1u << i % BITS_IN_WORD);
+    }
+    file->WriteAt((char *)&map[first], (i - first) * sizeof(unsigned),
+                  first * sizeof(unsigned));
+  }
+}
@@ -28,6 +28,12 @@
 ///
 /// Each bit represents whether the corresponding sector or page is in use
 /// or free.
+///
+/// Searches go a word at a time.  The number of clear bits is kept up to
+/// date, and so is a hint of where the first clear bit may be.  Maps of at
+/// least `BITS_IN_WORD` words also keep a summary with one bit per word,
+/// set when the word is full, so that full regions are skipped 32 words
+/// at a time.
 class Bitmap
 {
 public:
@@ -53,9 +59,23 @@ public:
   /// If no bits are clear, return -1.
   int Find();
 
+  /// Same as `Find`, but look at `start` first and then onwards, wrapping
+  /// around at the end.
+  int FindFrom(unsigned start);
+
+  /// Return the first of `n` consecutive clear bits at or after `start`,
+  /// and as a side effect, set them.  If `boundary` is not 0, the run may
+  /// not straddle a multiple of it.
+  ///
+  /// If there is no such run, return -1.
+  int FindContiguous(unsigned n, unsigned start = 0, unsigned boundary = 0);
+
   /// Return the number of clear bits.
   unsigned CountClear() const;
 
+  /// Return the number of bits.
+  unsigned GetNumBits() const;
+
   /// Print contents of bitmap.
   void Print() const;
 
@@ -71,6 +91,10 @@ public:
   /// need to read and write the bitmap to a file.
   void WriteBack(OpenFile *file) const;
 
+  /// Write only the words changed since the last `FetchFrom` or
+  /// `WriteDirty`.
+  void WriteDirty(OpenFile *file);
+
 #ifdef SWAP
   Coremap *coremapEntries;
 #endif
@@ -83,8 +107,43 @@ private:
   /// multiple of the number of bits in a word).
   unsigned numWords;
 
-  /// Bit storage.
+  /// Bit storage.  Bits past `numBits` are kept set.
   unsigned *map;
+
+  /// Number of clear bits.
+  unsigned numClear;
+
+  /// No bit below this one is clear.
+  unsigned firstClearHint;
+
+  /// One bit per word of `map`, set when the word is full.  Null for
+  /// small maps.
+  unsigned *fullWords;
+
+  /// One bit per word of `map`, set when the word has not been written
+  /// back yet.
+  unsigned *dirtyWords;
+
+  /// Index of the first clear bit at or after `start`, -1 if none.
+  int NextClear(unsigned start) const;
+
+  /// Index of the first set bit at or after `start`, `numBits` if none.
+  unsigned NextSet(unsigned start) const;
+
+  /// First word at or after `word` that has a clear bit, `numWords` if
+  /// none.
+  unsigned NextNonFullWord(unsigned word) const;
+
+  /// Set bits `first` to `first + n - 1`, which must all be clear.
+  void MarkRange(unsigned first, unsigned n);
+
+  /// Keep the summary and dirty bits of `word` up to date after a change.
+  void WordChanged(unsigned word);
+
+  void UpdateSummary(unsigned word);
+
+  /// Recompute the derived state after `map` was loaded wholesale.
+  void Recount();
 };
 
 #endif
\ No newline at end of file
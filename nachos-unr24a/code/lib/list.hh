@@ -64,6 +64,9 @@ public:
     /// Apply `func` to all elements in list.
     void Apply(void (*func)(Item));
 
+    /// Apply `func` to all elements in list, passing `arg` along.
+    void Apply(void (*func)(Item, void *), void *arg);
+
     /// Does the list have some item?
     bool Has(Item item) const;
 
@@ -230,6 +233,19 @@ List<Item>::Apply(void (*func)(Item))
     }
 }
 
+/// Same as above, but `func` also receives `arg`, so that it can
+/// accumulate a result.
+template <class Item>
+void
+List<Item>::Apply(void (*func)(Item, void *), void *arg)
+{
+    ASSERT(func != nullptr);
+
+    for (ListNode *ptr = first; ptr != nullptr; ptr = ptr->next) {
+       func(ptr->item, arg);
+    }
+}
+
 template <class Item>
 bool
 List<Item>::Has(Item item) const
@@ -7,22 +7,38 @@
 #ifndef NACHOS_LIB_TABLE__HH
 #define NACHOS_LIB_TABLE__HH
 
-#include "list.hh"
+#include "utility.hh"
 
+/// Indexes are handed out from a free list and the table doubles its size
+/// when it runs out of them, so there is no limit on how many items it can
+/// hold, and adding, getting and removing an item take constant time.
+///
+/// Items may also be added under a key (a disk sector, for instance), to
+/// be found later with `Find` without walking the whole table.
 template <class T>
 class Table
 {
 public:
+  /// Number of indexes a table starts with.
   static const unsigned SIZE = 20;
 
   /// Construct an empty table.
   Table();
 
+  /// De-allocate the table, but not the items in it.
+  ~Table();
+
   /// Add an item into a free index.
   ///
-  /// Returns -1 if no space is left to add the item.
+  /// Returns the index.
   int Add(T item);
 
+  /// Add an item into a free index, so that `Find(key)` returns it.
+  int Add(T item, unsigned key);
+
+  /// Return the index of an item added under `key`, or -1.
+  int Find(unsigned key) const;
+
   /// Get the item associated with a given index.
   T Get(int i) const;
 
@@ -32,6 +48,9 @@ public:
   /// Check whether the table is empty.
   bool IsEmpty() const;
 
+  /// One more than the greatest index in use, to walk the table.
+  unsigned Size() const;
+
   /// Remove the item associated with a given index.
   ///
   /// Returns the removed item, or `T()` if the index is already
@@ -46,23 +65,55 @@ public:
   T Update(int i, T item);
 
 private:
+  static const unsigned NUM_BUCKETS = 32;
+
+  struct Slot
+  {
+    T item;
+    bool used;
+    bool keyed;
+    unsigned key;
+    /// Next free index if the slot is free, next index in the same bucket
+    /// if it holds a keyed item; -1 ends both lists.
+    int next;
+  };
+
   /// Data items.
-  T data[SIZE];
+  Slot *slots;
+
+  /// Number of slots.
+  unsigned capacity;
 
   /// Current greatest index for a new item.
   int current;
 
-  /// A list to store indexes of items that have been freed and are not
-  /// among those with greatest numbers, so it is not possible to modify
-  /// `current`.  In other words, this keeps track of external
-  /// fragmentation.
-  List<int> freed;
+  /// First of the indexes below `current` that have been freed.
+  int freeHead;
+
+  /// Number of items in the table.
+  unsigned count;
+
+  /// Keyed items by `key % NUM_BUCKETS`; allocated on the first keyed
+  /// `Add`, so that tables that do not use keys do not pay for it.
+  int *buckets;
 };
 
 template <class T>
 Table<T>::Table()
 {
+  capacity = SIZE;
+  slots = new Slot[capacity];
   current = 0;
+  freeHead = -1;
+  count = 0;
+  buckets = nullptr;
+}
+
+template <class T>
+Table<T>::~Table()
+{
+  delete[] slots;
+  delete[] buckets;
 }
 
 template <class T>
@@ -70,22 +121,63 @@ int Table<T>::Add(T item)
 {
   int i;
 
-  if (!freed.IsEmpty())
+  if (freeHead != -1)
   {
-    i = freed.Pop();
-    data[i] = item;
-    return i;
+    i = freeHead;
+    freeHead = slots[i].next;
   }
-  else if (current < static_cast<int>(SIZE))
+  else
   {
+    if (static_cast<unsigned>(current) == capacity)
+    {
+      Slot *larger = new Slot[capacity * 2];
+      for (unsigned j = 0; j < capacity; j++)
+        larger[j] = slots[j];
+      delete[] slots;
+      slots = larger;
+      capacity *= 2;
+    }
     i = current++;
-    data[i] = item;
-    return i;
   }
-  else
+
+  slots[i].item = item;
+  slots[i].used = true;
+  slots[i].keyed = false;
+  count++;
+  return i;
+}
+
+template <class T>
+int Table<T>::Add(T item, unsigned key)
+{
+  if (buckets == nullptr)
   {
+    buckets = new int[NUM_BUCKETS];
+    for (unsigned b = 0; b < NUM_BUCKETS; b++)
+      buckets[b] = -1;
+  }
+
+  int i = Add(item);
+  unsigned b = key % NUM_BUCKETS;
+  slots[i].keyed = true;
+  slots[i].key = key;
+  slots[i].next = buckets[b];
+  buckets[b] = i;
+  return i;
+}
+
+template <class T>
+int Table<T>::Find(unsigned key) const
+{
+  if (buckets == nullptr)
     return -1;
+
+  for (int i = buckets[key % NUM_BUCKETS]; i != -1; i = slots[i].next)
+  {
+    if (slots[i].key == key)
+      return i;
   }
+  return -1;
 }
 
 template <class T>
@@ -93,7 +185,7 @@ T Table<T>::Get(int i) const
 {
   ASSERT(i >= 0);
 
-  return HasKey(i) ? data[i] : T();
+  return HasKey(i) ? slots[i].item : T();
 }
 
 template <class T>
@@ -101,13 +193,19 @@ bool Table<T>::HasKey(int i) const
 {
   ASSERT(i >= 0);
 
-  return i < current && !freed.Has(i);
+  return i < current && slots[i].used;
 }
 
 template <class T>
 bool Table<T>::IsEmpty() const
 {
-  return current == 0;
+  return count == 0;
+}
+
+template <class T>
+unsigned Table<T>::Size() const
+{
+  return current;
 }
 
 template <class T>
@@ -120,21 +218,29 @@ T Table<T>::Remove(int i)
     return T();
   }
 
+  if (slots[i].keyed)
+  {
+    int *p = &buckets[slots[i].key % NUM_BUCKETS];
+    while (*p != i)
+      p = &slots[*p].next;
+    *p = slots[i].next;
+  }
+
+  T item = slots[i].item;
+  slots[i].item = T();
+  slots[i].used = false;
+  count--;
+
   if (i == current - 1)
   {
     current--;
-    for (int j = current - 1; j >= 0 && !HasKey(j); j--)
-    {
-      ASSERT(freed.Has(j));
-      freed.Remove(j);
-      current--;
-    }
   }
   else
   {
-    freed.SortedInsert(i, i);
+    slots[i].next = freeHead;
+    freeHead = i;
   }
-  return data[i];
+  return item;
 }
 
 template <class T>
@@ -142,10 +248,10 @@ T Table<T>::Update(int i, T item)
 {
   ASSERT(i >= 0);
   ASSERT(i < current);
-  ASSERT(!freed.Has(i));
+  ASSERT(slots[i].used);
 
-  T previous = data[i];
-  data[i] = item;
+  T previous = slots[i].item;
+  slots[i].item = item;
   return previous;
 }
 
@@ -18,6 +18,7 @@
 #include "threads/system.hh"
 
 #include <stdio.h>
+#include <string.h>
 
 
 /// We put this at the front of the UNIX file representing the
@@ -26,8 +27,6 @@
 static const unsigned MAGIC_NUMBER = 0x456789AB;
 static const unsigned MAGIC_SIZE = sizeof (int);
 
-static const unsigned DISK_SIZE = MAGIC_SIZE + NUM_SECTORS * SECTOR_SIZE;
-
 /// dummy procedure because we cannot take a pointer of a member function
 static void
 DiskDone(void *arg)
@@ -41,16 +40,18 @@ DiskDone(void *arg)
 /// treat it as Nachos disk storage.
 //
 /// * `name` is the text name of the file simulating the Nachos disk.
+/// * `sectorsPerTrack`, `numTracks` give the geometry of the disk.
+/// * `mode` tells how to reach the file.
 /// * `callWhenDone` is an interrupt handler to be called when disk
 ///   read/write request completes.
 /// * `callArg` is an argument to pass the interrupt handler.
-Disk::Disk(const char *name, VoidFunctionPtr callWhenDone, void *callArg)
+Disk::Disk(const char *name, unsigned sectorsPerTrack_, unsigned numTracks_,
+           DiskMode mode_, VoidFunctionPtr callWhenDone, void *callArg)
 {
     ASSERT(name != nullptr);
     ASSERT(callWhenDone != nullptr);
 
     int magicNum;
-    int tmp = 0;
 
     DEBUG('d', "Initializing the disk, 0x%X 0x%X\n", callWhenDone, callArg);
     handler    = callWhenDone;
@@ -67,20 +68,92 @@ Disk::Disk(const char *name, VoidFunctionPtr callWhenDone, void *callArg)
         magicNum = MAGIC_NUMBER;
         SystemDep::WriteFile(fileno, (char *) &magicNum, MAGIC_SIZE);
           // Write magic number.
+    }
 
-        // Need to write at end of file, so that reads will not return EOF.
-        SystemDep::Lseek(fileno, DISK_SIZE - sizeof (int), 0);
-        SystemDep::WriteFile(fileno, (char *) &tmp, sizeof (int));
+    mode = mode_;
+    mapping = nullptr;
+    mappedSize = 0;
+    directFileno = -1;
+    directBuffer = nullptr;
+    if (mode == DISK_DIRECT) {
+        directFileno = SystemDep::OpenForReadWriteDirect(name);
+        if (directFileno >= 0) {
+            directBuffer = SystemDep::AllocAligned(
+              (DivRoundUp((size_t) MAX_REQUEST_SECTORS * SECTOR_SIZE,
+                          SystemDep::DIRECT_IO_ALIGNMENT) + 1)
+              * SystemDep::DIRECT_IO_ALIGNMENT);
+        } else {
+            DEBUG('d', "Unbuffered I/O not available for %s\n", name);
+            mode = DISK_SYSCALL;
+        }
     }
+
+    sectorsPerTrack = 0;
+    numTracks = 0;
+    SetGeometry(sectorsPerTrack_, numTracks_);
     active = false;
 }
 
 /// Clean up disk simulation, by closing the UNIX file representing the disk.
 Disk::~Disk()
 {
+    if (mapping != nullptr) {
+        SystemDep::SyncMapping(mapping, mappedSize);
+        SystemDep::UnmapFile(mapping, mappedSize);
+    }
+    if (directFileno >= 0) {
+        SystemDep::Close(directFileno);
+        SystemDep::DeallocAligned(directBuffer);
+    }
     SystemDep::Close(fileno);
 }
 
+/// The file only grows: sectors dropped by a smaller geometry are kept, in
+/// case a later one brings them back.
+void
+Disk::SetGeometry(unsigned sectorsPerTrack_, unsigned numTracks_)
+{
+    ASSERT(sectorsPerTrack_ > 0 && numTracks_ > 0);
+
+    DEBUG('d', "Disk geometry: %u tracks of %u sectors\n",
+          numTracks_, sectorsPerTrack_);
+    sectorsPerTrack = sectorsPerTrack_;
+    numTracks = numTracks_;
+
+    // Need the whole disk in the file, so that reads will not return EOF.
+    size_t size = MAGIC_SIZE + (size_t) GetNumSectors() * SECTOR_SIZE;
+    SystemDep::Lseek(fileno, 0, SEEK_END);
+    if ((size_t) SystemDep::Tell(fileno) < size) {
+        SystemDep::ResizeFile(fileno, size);
+    }
+
+    if (mode == DISK_MAPPED && size != mappedSize) {
+        if (mapping != nullptr) {
+            SystemDep::UnmapFile(mapping, mappedSize);
+        }
+        mapping = SystemDep::MapFile(fileno, size);
+        mappedSize = size;
+    }
+}
+
+unsigned
+Disk::GetSectorsPerTrack() const
+{
+    return sectorsPerTrack;
+}
+
+unsigned
+Disk::GetNumTracks() const
+{
+    return numTracks;
+}
+
+unsigned
+Disk::GetNumSectors() const
+{
+    return sectorsPerTrack * numTracks;
+}
+
 /// Dump the data in a disk read/write request, for debugging.
 static void
 PrintSector(bool writing, unsigned sector, const char *data)
@@ -102,12 +175,16 @@ PrintSector(bool writing, unsigned sector, const char *data)
 
 /// Disk::ReadRequest/WriteRequest
 ///
-/// Simulate a request to read/write a single disk sector.
+/// Simulate a request to read/write disk sectors.
 ///
 /// Do the read/write immediately to the UNIX file.  Set up an interrupt
 /// handler to be called later, that will notify the caller when the
 /// simulator says the operation has completed.
 ///
+/// A request for several sectors costs what reading them one after the
+/// other costs the head, but raises a single interrupt: consecutive sectors
+/// pay for one seek and then one rotation each.
+///
 /// Note that a disk only allows an entire sector to be read/written, not
 /// part of a sector.
 ///
@@ -117,49 +194,157 @@ PrintSector(bool writing, unsigned sector, const char *data)
 void
 Disk::ReadRequest(unsigned sectorNumber, char *data)
 {
-    ASSERT(data != nullptr);
+    ReadRequest(sectorNumber, 1, data);
+}
 
-    int ticks = ComputeLatency(sectorNumber, false);
+void
+Disk::WriteRequest(unsigned sectorNumber, const char *data)
+{
+    WriteRequest(sectorNumber, 1, data);
+}
 
+void
+Disk::ReadRequest(unsigned firstSector, unsigned count, char *data)
+{
+    ASSERT(data != nullptr);
     ASSERT(!active);  // only one request at a time
-    ASSERT(sectorNumber >= 0 && sectorNumber < NUM_SECTORS);
+    ASSERT(0 < count && count <= MAX_REQUEST_SECTORS);
+    ASSERT(firstSector + count <= GetNumSectors());
 
-    DEBUG('d', "Reading from sector %u\n", sectorNumber);
-    SystemDep::Lseek(fileno, SECTOR_SIZE * sectorNumber + MAGIC_SIZE, 0);
-    SystemDep::Read(fileno, data, SECTOR_SIZE);
-    if (debug.IsEnabled('d')) {
-        PrintSector(false, sectorNumber, data);
+    unsigned ticks = 0;
+    for (unsigned i = 0; i < count; i++) {
+        Visit(firstSector + i, false, &ticks);
     }
-
-    active = true;
-    UpdateLast(sectorNumber);
-    stats->numDiskReads++;
-    interrupt->Schedule(DiskDone, this, ticks, DISK_INT);
+    DEBUG('d', "Reading from sectors %u to %u\n",
+          firstSector, firstSector + count - 1);
+    Transfer(firstSector, count, data, false);
+    Start(ticks, count, false);
 }
 
 void
-Disk::WriteRequest(unsigned sectorNumber, const char *data)
+Disk::WriteRequest(unsigned firstSector, unsigned count, const char *data)
 {
     ASSERT(data != nullptr);
+    ASSERT(!active);
+    ASSERT(0 < count && count <= MAX_REQUEST_SECTORS);
+    ASSERT(firstSector + count <= GetNumSectors());
 
-    int ticks = ComputeLatency(sectorNumber, true);
+    unsigned ticks = 0;
+    for (unsigned i = 0; i < count; i++) {
+        Visit(firstSector + i, true, &ticks);
+    }
+    DEBUG('d', "Writing to sectors %u to %u\n",
+          firstSector, firstSector + count - 1);
+    Transfer(firstSector, count, (char *) data, true);
+    Start(ticks, count, true);
+}
 
+void
+Disk::ReadRequest(const unsigned *sectors, char *const *data, unsigned count)
+{
+    ASSERT(sectors != nullptr && data != nullptr);
     ASSERT(!active);
-    ASSERT(sectorNumber >= 0 && sectorNumber < NUM_SECTORS);
+    ASSERT(0 < count && count <= MAX_REQUEST_SECTORS);
+
+    unsigned ticks = 0;
+    for (unsigned i = 0; i < count; i++) {
+        ASSERT(sectors[i] < GetNumSectors());
+        Visit(sectors[i], false, &ticks);
+        DEBUG('d', "Reading from sector %u\n", sectors[i]);
+        Transfer(sectors[i], 1, data[i], false);
+    }
+    Start(ticks, count, false);
+}
 
-    DEBUG('d', "Writing to sector %u\n", sectorNumber);
-    SystemDep::Lseek(fileno, SECTOR_SIZE * sectorNumber + MAGIC_SIZE, 0);
-    SystemDep::WriteFile(fileno, data, SECTOR_SIZE);
-    if (debug.IsEnabled('d')) {
-        PrintSector(true, sectorNumber, data);
+void
+Disk::WriteRequest(const unsigned *sectors, const char *const *data,
+                   unsigned count)
+{
+    ASSERT(sectors != nullptr && data != nullptr);
+    ASSERT(!active);
+    ASSERT(0 < count && count <= MAX_REQUEST_SECTORS);
+
+    unsigned ticks = 0;
+    for (unsigned i = 0; i < count; i++) {
+        ASSERT(sectors[i] < GetNumSectors());
+        Visit(sectors[i], true, &ticks);
+        DEBUG('d', "Writing to sector %u\n", sectors[i]);
+        Transfer(sectors[i], 1, (char *) data[i], true);
     }
+    Start(ticks, count, true);
+}
+
+void
+Disk::Visit(unsigned sectorNumber, bool writing, unsigned *ticks)
+{
+    unsigned long now = stats->totalTicks + *ticks;
+    *ticks += LatencyAt(sectorNumber, writing, now);
+    UpdateLast(sectorNumber, now);
+}
 
+void
+Disk::Start(unsigned ticks, unsigned count, bool writing)
+{
     active = true;
-    UpdateLast(sectorNumber);
-    stats->numDiskWrites++;
+    if (writing) {
+        stats->numDiskWrites++;
+        stats->numDiskSectorsWritten += count;
+    } else {
+        stats->numDiskReads++;
+        stats->numDiskSectorsRead += count;
+    }
     interrupt->Schedule(DiskDone, this, ticks, DISK_INT);
 }
 
+/// Unbuffered transfers must be of whole aligned blocks, and sectors are
+/// not (the magic number shifts them, and they are smaller), so the blocks
+/// around them are read, and written back after changing them.
+void
+Disk::Transfer(unsigned sectorNumber, unsigned count, char *data,
+               bool writing)
+{
+    size_t offset = MAGIC_SIZE + (size_t) sectorNumber * SECTOR_SIZE;
+    size_t size = count * SECTOR_SIZE;
+
+    switch (mode) {
+        case DISK_MAPPED:
+            if (writing) {
+                memcpy(&mapping[offset], data, size);
+            } else {
+                memcpy(data, &mapping[offset], size);
+            }
+            break;
+
+        case DISK_DIRECT: {
+            const size_t block = SystemDep::DIRECT_IO_ALIGNMENT;
+            size_t first = offset / block * block;
+            size_t length = DivRoundUp(offset + size, block) * block - first;
+            SystemDep::ReadAt(directFileno, directBuffer, length, first);
+            if (writing) {
+                memcpy(&directBuffer[offset - first], data, size);
+                SystemDep::WriteAt(directFileno, directBuffer, length, first);
+            } else {
+                memcpy(data, &directBuffer[offset - first], size);
+            }
+            break;
+        }
+
+        default:
+            SystemDep::Lseek(fileno, offset, 0);
+            if (writing) {
+                SystemDep::WriteFile(fileno, data, size);
+            } else {
+                SystemDep::Read(fileno, data, size);
+            }
+    }
+
+    if (debug.IsEnabled('d')) {
+        for (unsigned i = 0; i < count; i++) {
+            PrintSector(writing, sectorNumber + i, &data[i * SECTOR_SIZE]);
+        }
+    }
+}
+
 /// Called when it is time to invoke the disk interrupt handler, to tell the
 /// Nachos kernel that the disk request is done.
 void
@@ -183,15 +368,15 @@ Diff(unsigned a, unsigned b)
 /// Disk seeks at one track per `SEEK_TIME` ticks (cf. `stats.hh`) and
 /// rotates at one sector per `ROTATION_TIME` ticks.
 unsigned
-Disk::TimeToSeek(unsigned newSector, unsigned *rotation)
+Disk::TimeToSeek(unsigned newSector, unsigned long now, unsigned *rotation)
 {
     ASSERT(rotation != nullptr);
 
-    unsigned newTrack = newSector / SECTORS_PER_TRACK;
-    unsigned oldTrack = lastSector / SECTORS_PER_TRACK;
+    unsigned newTrack = newSector / sectorsPerTrack;
+    unsigned oldTrack = lastSector / sectorsPerTrack;
     unsigned seek = Diff(newTrack, oldTrack) * SEEK_TIME;
       // How long will seek take?
-    unsigned over = (stats->totalTicks + seek) % ROTATION_TIME;
+    unsigned over = (now + seek) % ROTATION_TIME;
       // Will we be in the middle of a sector when we finish the seek?
 
     *rotation = 0;
@@ -206,10 +391,10 @@ Disk::TimeToSeek(unsigned newSector, unsigned *rotation)
 unsigned
 Disk::ModuloDiff(unsigned to, unsigned from)
 {
-    unsigned toOffset   = to % SECTORS_PER_TRACK;
-    unsigned fromOffset = from % SECTORS_PER_TRACK;
+    unsigned toOffset   = to % sectorsPerTrack;
+    unsigned fromOffset = from % sectorsPerTrack;
 
-    return (toOffset - fromOffset + SECTORS_PER_TRACK) % SECTORS_PER_TRACK;
+    return (toOffset - fromOffset + sectorsPerTrack) % sectorsPerTrack;
 }
 
 /// Return how long will it take to read/write a disk sector, from
@@ -230,10 +415,16 @@ Disk::ModuloDiff(unsigned to, unsigned from)
 /// of the track buffer are discarded after every seek to a new track.
 int
 Disk::ComputeLatency(unsigned newSector, bool writing)
+{
+    return LatencyAt(newSector, writing, stats->totalTicks);
+}
+
+unsigned
+Disk::LatencyAt(unsigned newSector, bool writing, unsigned long now)
 {
     unsigned rotation;
-    unsigned seek      = TimeToSeek(newSector, &rotation);
-    unsigned timeAfter = stats->totalTicks + seek + rotation;
+    unsigned seek      = TimeToSeek(newSector, now, &rotation);
+    unsigned timeAfter = now + seek + rotation;
 
 #ifndef NOTRACKBUF  // Turn this on if you do not want the track buffer
                     // stuff.
@@ -257,13 +448,13 @@ Disk::ComputeLatency(unsigned newSector, bool writing)
 /// Keep track of the most recently requested sector.  So we can know what is
 /// in the track buffer.
 void
-Disk::UpdateLast(unsigned newSector)
+Disk::UpdateLast(unsigned newSector, unsigned long now)
 {
     unsigned rotate;
-    unsigned seek = TimeToSeek(newSector, &rotate);
+    unsigned seek = TimeToSeek(newSector, now, &rotate);
 
     if (seek != 0) {
-        bufferInit = stats->totalTicks + seek + rotate;
+        bufferInit = now + seek + rotate;
     }
     lastSector = newSector;
     DEBUG('d', "Updating last sector = %u, %u\n", lastSector, bufferInit);
@@ -1,8 +1,8 @@
 /// Data structures to emulate a physical disk.
 ///
-/// A physical disk can accept (one at a time) requests to read/write a disk
-/// sector; when the request is satisfied, the CPU gets an interrupt, and the
-/// next request can be sent to the disk.
+/// A physical disk can accept (one at a time) requests to read/write disk
+/// sectors; when the request is satisfied, the CPU gets an interrupt, and
+/// the next request can be sent to the disk.
 ///
 /// Disk contents are preserved across machine crashes, but if a file system
 /// operation (eg, create a file) is in progress when the system shuts down,
@@ -29,7 +29,7 @@
 /// each sector has the same number of bytes of storage).
 ///
 /// Addressing is by sector number -- each sector on the disk is given a
-/// unique number: `track * SECTORS_PER_TRACK + offset` within a track.
+/// unique number: `track * sectorsPerTrack + offset` within a track.
 ///
 /// As with other I/O devices, the raw physical disk is an asynchronous
 /// device -- requests to read or write portions of the disk return
@@ -50,22 +50,49 @@
 ///
 /// The track buffer simulation can be disabled by compiling with
 /// `-DNOTRACKBUF`.
-
-const unsigned SECTOR_SIZE = 128;       ///< Number of bytes per disk sector.
-const unsigned SECTORS_PER_TRACK = 32;  ///< Number of sectors per disk
-                                        ///< track.
-const unsigned NUM_TRACKS = 32;         ///< Number of tracks per disk.
-const unsigned NUM_SECTORS = SECTORS_PER_TRACK * NUM_TRACKS;
-  ///< Total # of sectors per disk.
+///
+/// How the UNIX file is accessed only changes how long the simulation takes
+/// on the host, not the simulated times: see `DiskMode`.
+
+const unsigned SECTOR_SIZE = 128;  ///< Number of bytes per disk sector.
+
+/// Geometry of a disk when nothing else is asked for: 32 tracks of 32
+/// sectors.  Any other can be given when the disk is created, or later
+/// with `SetGeometry`; sector numbers go from 0 to `GetNumSectors() - 1`.
+const unsigned DEFAULT_SECTORS_PER_TRACK = 32;
+const unsigned DEFAULT_NUM_TRACKS = 32;
+
+/// Most sectors a single request may transfer.
+const unsigned MAX_REQUEST_SECTORS = 32;
+
+/// Ways to reach the UNIX file holding the disk.
+enum DiskMode {
+    DISK_MAPPED,  ///< Mapped into memory once; sectors are copied in and
+                  ///< out, and the file is synchronized when the disk is
+                  ///< deleted.
+    DISK_SYSCALL, ///< A seek and a read or write call for every sector.
+    DISK_DIRECT   ///< Like `DISK_SYSCALL`, bypassing the buffers of the
+                  ///< host, to measure its I/O.  Falls back to
+                  ///< `DISK_SYSCALL` where the host cannot do it.
+};
 
 class Disk {
 public:
     /// Create a simulated disk.
     ///
     /// Invoke `(*callWhenDone)(callArg)` every time a request completes.
-    Disk(const char *name, VoidFunctionPtr callWhenDone, void *callArg);
+    Disk(const char *name, unsigned sectorsPerTrack, unsigned numTracks,
+         DiskMode mode, VoidFunctionPtr callWhenDone, void *callArg);
     ~Disk();  // Deallocate the disk.
 
+    /// Change the number of tracks and of sectors in each, keeping the
+    /// contents of the sectors that remain.
+    void SetGeometry(unsigned sectorsPerTrack, unsigned numTracks);
+
+    unsigned GetSectorsPerTrack() const;
+    unsigned GetNumTracks() const;
+    unsigned GetNumSectors() const;
+
     /// Read/write an single disk sector.
     ///
     /// These routines send a request to the disk and return immediately.
@@ -74,6 +101,20 @@ public:
     void ReadRequest(unsigned sectorNumber, char *data);
     void WriteRequest(unsigned sectorNumber, const char *data);
 
+    /// Read/write `count` consecutive sectors, starting at `firstSector`,
+    /// from/to the `count * SECTOR_SIZE` bytes at `data`, in one request.
+
+    void ReadRequest(unsigned firstSector, unsigned count, char *data);
+    void WriteRequest(unsigned firstSector, unsigned count, const char *data);
+
+    /// Read/write `sectors[i]` from/to `data[i]`, for `i` below `count`, in
+    /// one request.  Sectors are visited in the order given.
+
+    void ReadRequest(const unsigned *sectors, char *const *data,
+                     unsigned count);
+    void WriteRequest(const unsigned *sectors, const char *const *data,
+                      unsigned count);
+
     /// Interrupt handler, invoked when disk request finishes.
     void HandleInterrupt();
 
@@ -84,6 +125,13 @@ public:
 
 private:
     int fileno;  ///< UNIX file number for simulated disk.
+    DiskMode mode;
+    char *mapping;      ///< The whole file, if `DISK_MAPPED`.
+    size_t mappedSize;
+    int directFileno;   ///< Opened for `DISK_DIRECT`.
+    char *directBuffer; ///< Aligned blocks around a request.
+    unsigned sectorsPerTrack;
+    unsigned numTracks;
     VoidFunctionPtr handler;  ///< Interrupt handler, to be invoked when any
                               ///< disk request finishes.
     void *handlerArg;  ///< Argument to interrupt handler.
@@ -92,13 +140,28 @@ private:
     int bufferInit;  ///< When the track buffer started being loaded.
                      // being loaded
 
-    /// Time to get to the new track.
-    unsigned TimeToSeek(unsigned newSector, unsigned *rotate);
+    /// Time to get to the new track, starting at tick `now`.
+    unsigned TimeToSeek(unsigned newSector, unsigned long now,
+                        unsigned *rotate);
 
     /// Number of sectors between `to` and `from`.
     unsigned ModuloDiff(unsigned to, unsigned from);
 
-    void UpdateLast(unsigned newSector);
+    /// Latency of a sector, if the head starts moving to it at tick `now`.
+    unsigned LatencyAt(unsigned newSector, bool writing, unsigned long now);
+
+    void UpdateLast(unsigned newSector, unsigned long now);
+
+    /// Add sector `sectorNumber` to the request being built, which takes
+    /// `*ticks` so far.
+    void Visit(unsigned sectorNumber, bool writing, unsigned *ticks);
+
+    /// Send the request built for `count` sectors.
+    void Start(unsigned ticks, unsigned count, bool writing);
+
+    /// Copy `count` sectors starting at `sectorNumber` to or from `data`.
+    void Transfer(unsigned sectorNumber, unsigned count, char *data,
+                  bool writing);
 };
 
 
@@ -75,6 +75,8 @@ Interrupt::Interrupt()
     inHandler     = false;
     yieldOnReturn = false;
     status        = SYSTEM_MODE;
+    nextDue       = ULONG_MAX;
+    pendingUserTicks = 0;
 }
 
 /// De-allocate the data structures needed by the interrupt simulation.
@@ -145,7 +147,7 @@ Interrupt::Enable()
 void
 Interrupt::OneTick()
 {
-    MachineStatus old = status;
+    FlushUserTicks();
 
     // Advance simulated time.
     if (status == SYSTEM_MODE) {
@@ -157,6 +159,51 @@ Interrupt::OneTick()
     }
     DEBUG('i', "== Tick %u ==\n", stats->totalTicks);
 
+    // Nothing can fire before `nextDue`, so most ticks end here without
+    // looking at the pending list.
+    if (stats->totalTicks < nextDue && !yieldOnReturn) {
+        return;
+    }
+    CheckPending();
+}
+
+/// Account for one user instruction.
+///
+/// Called by `Machine::Run` instead of `OneTick`.  The ticks are only
+/// added to `stats` once an interrupt becomes due, so between two events
+/// the simulator just bumps a counter.  Anything that leaves user mode
+/// (an exception or a system call) goes through `SetStatus`, which
+/// settles the count first, so the kernel always sees an exact clock.
+void
+Interrupt::UserTick()
+{
+    pendingUserTicks += USER_TICK;
+    if (stats->totalTicks + pendingUserTicks < nextDue && !yieldOnReturn) {
+        return;
+    }
+    FlushUserTicks();
+    DEBUG('i', "== Tick %u ==\n", stats->totalTicks);
+    CheckPending();
+}
+
+void
+Interrupt::FlushUserTicks()
+{
+    if (pendingUserTicks == 0) {
+        return;
+    }
+    stats->totalTicks += pendingUserTicks;
+    stats->userTicks += pendingUserTicks;
+    pendingUserTicks = 0;
+}
+
+/// Run the handlers of every interrupt that is due, and then context
+/// switch if the timer asked for it.
+void
+Interrupt::CheckPending()
+{
+    MachineStatus old = status;
+
     // Check any pending interrupts are now ready to fire.
     ChangeLevel(INT_ON, INT_OFF);  // First, turn off interrupts (interrupt
                                    // handlers run with interrupts disabled).
@@ -222,6 +269,7 @@ Interrupt::Idle()
 void
 Interrupt::Halt()
 {
+    FlushUserTicks();
     printf("Machine halting!\n\n");
     stats->Print();
     Cleanup();  // Never returns.
@@ -244,6 +292,7 @@ Interrupt::RestartTicks()
     unsigned          oldWhen = 0;
     while ((i = oldPending->SortedPop((int *) &oldWhen)) != nullptr) {
         unsigned newWhen = oldWhen - stats->totalTicks;
+        i->when = newWhen;
         pending->SortedInsert(i, newWhen);
         DEBUG('x', "Interrupt at time %u re-scheduled at new time %u.\n",
               oldWhen, newWhen);
@@ -252,6 +301,7 @@ Interrupt::RestartTicks()
     delete oldPending;
     stats->totalTicks = 0;
     stats->tickResets += 1;
+    UpdateNextDue();
 }
 #endif
 
@@ -295,6 +345,15 @@ Interrupt::Schedule(VoidFunctionPtr handler, void *arg,
           INT_TYPE_NAMES[type], when);
 
     pending->SortedInsert(toOccur, when);
+    UpdateNextDue();
+}
+
+/// Only the head of `pending` is ever examined by `CheckIfDue`, so its
+/// time is the earliest moment at which the pending list can matter.
+void
+Interrupt::UpdateNextDue()
+{
+    nextDue = pending->IsEmpty() ? ULONG_MAX : pending->Head()->when;
 }
 
 /// Check if an interrupt is scheduled to occur, and if so, fire it off.
@@ -319,6 +378,7 @@ Interrupt::CheckIfDue(bool advanceClock)
     PendingInterrupt *toOccur = pending->SortedPop((int *) &when);
 
     if (toOccur == nullptr) {  // No pending interrupts.
+        nextDue = ULONG_MAX;
         return false;
     }
 
@@ -327,6 +387,7 @@ Interrupt::CheckIfDue(bool advanceClock)
         stats->totalTicks = when;
     } else if (when > stats->totalTicks) {  // Not time yet, put it back.
         pending->SortedInsert(toOccur, when);
+        UpdateNextDue();
         return false;
     }
 
@@ -334,6 +395,7 @@ Interrupt::CheckIfDue(bool advanceClock)
     if (status == IDLE_MODE && toOccur->type == TIMER_INT
           && pending->IsEmpty()) {
         pending->SortedInsert(toOccur, when);
+        UpdateNextDue();
         return false;
     }
 
@@ -351,6 +413,7 @@ Interrupt::CheckIfDue(bool advanceClock)
     status = old;  // Restore the machine status.
     inHandler = false;
     delete toOccur;
+    UpdateNextDue();
     return true;
 }
 
@@ -369,6 +432,9 @@ Interrupt::GetStatus() const
 void
 Interrupt::SetStatus(MachineStatus st)
 {
+    if (st != USER_MODE) {
+        FlushUserTicks();
+    }
     status = st;
 }
 
@@ -143,6 +143,13 @@ public:
     /// Advance simulated time.
     void OneTick();
 
+    /// Account for one user instruction.
+    ///
+    /// Cheaper than `OneTick`: user ticks are accumulated and only folded
+    /// into the statistics when the next interrupt is due, or when the
+    /// machine leaves user mode.
+    void UserTick();
+
 private:
     IntStatus level;  ///< Are interrupts enabled or disabled?
     List<PendingInterrupt *> *pending;  ///< The list of interrupts scheduled
@@ -151,12 +158,27 @@ private:
     bool yieldOnReturn;  ///< True if we are to context switch on return from
                          ///< the interrupt handler.
     MachineStatus status;  ///< Idle, kernel mode, user mode.
+    unsigned long nextDue;  ///< When the earliest pending interrupt is
+                            ///< supposed to fire; `ULONG_MAX` if there is
+                            ///< none.  Until `totalTicks` reaches it,
+                            ///< there is no need to look at `pending`.
+    unsigned long pendingUserTicks;  ///< User ticks executed but not yet
+                                     ///< added to the statistics.
 
     /// These functions are internal to the interrupt simulation code.
 
     /// Check if an interrupt is supposed to occur now.
     bool CheckIfDue(bool advanceClock);
 
+    /// Recompute `nextDue` from the head of `pending`.
+    void UpdateNextDue();
+
+    /// Add the batched user ticks to the statistics.
+    void FlushUserTicks();
+
+    /// Fire any due interrupts and honor `yieldOnReturn`.
+    void CheckPending();
+
     /// SetLevel, without advancing the simulated time.
     void ChangeLevel(IntStatus old,
                      IntStatus now);
@@ -39,9 +39,14 @@ Machine::Run()
         if (FetchInstruction(instr)) {
             ExecInstruction(instr);
         }
-        interrupt->OneTick();
-        if (singleStepper != nullptr && !singleStepper->Step()) {
-            singleStepper = nullptr;
+        if (singleStepper == nullptr && !debug.IsEnabled('i')) {
+            interrupt->UserTick();  // Ticks are batched until the next
+                                    // interrupt is due.
+        } else {
+            interrupt->OneTick();
+            if (singleStepper != nullptr && !singleStepper->Step()) {
+                singleStepper = nullptr;
+            }
         }
     }
 }
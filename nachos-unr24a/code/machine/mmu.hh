@@ -9,14 +9,13 @@
 #define NACHOS_MACHINE_MMU__HH
 
 #include "exception_type.hh"
-#include "disk.hh"
 #include "translation_entry.hh"
 
 /// Definitions related to the size, and format of user memory.
 
-const unsigned PAGE_SIZE = SECTOR_SIZE; ///< Set the page size equal to the
-                                        ///< disk sector size, for
-                                        ///< simplicity.
+const unsigned PAGE_SIZE = 128;  ///< Pages are read and written through
+                                 ///< files, so they need not match the
+                                 ///< disk sectors.
 const unsigned DEFAULT_NUM_PHYS_PAGES = 32;
 // const unsigned MEMORY_SIZE = NUM_PHYS_PAGES * PAGE_SIZE;
 
@@ -17,10 +17,13 @@ Statistics::Statistics()
 {
   totalTicks = idleTicks = systemTicks = userTicks = 0;
   numDiskReads = numDiskWrites = 0;
+  numDiskSectorsRead = numDiskSectorsWritten = 0;
   numConsoleCharsRead = numConsoleCharsWritten = 0;
   numPageFaults = 0;
   numSwapInPages = 0;
   numSwapOutPages = 0;
+  numCacheHits = numCacheMisses = numReadAheads = 0;
+  numJournalCommits = numJournalSectors = 0;
 #ifdef DFS_TICKS_FIX
   tickResets = 0;
 #endif
@@ -40,7 +43,15 @@ void Statistics::Print()
 #endif
   printf("Ticks: total %lu, idle %lu, system %lu, user %lu\n",
          totalTicks, idleTicks, systemTicks, userTicks);
-  printf("Disk I/O: reads %lu, writes %lu\n", numDiskReads, numDiskWrites);
+  printf("Disk I/O: reads %lu (%lu sectors), writes %lu (%lu sectors)\n",
+         numDiskReads, numDiskSectorsRead,
+         numDiskWrites, numDiskSectorsWritten);
+#ifdef FILESYS
+  printf("Block cache: hits %lu, misses %lu, read ahead %lu\n",
+         numCacheHits, numCacheMisses, numReadAheads);
+  printf("Journal: commits %lu, sectors %lu\n",
+         numJournalCommits, numJournalSectors);
+#endif
   printf("Console I/O: reads %lu, writes %lu\n",
          numConsoleCharsRead, numConsoleCharsWritten);
   printf("Paging: faults %lu\n", numPageFaults);
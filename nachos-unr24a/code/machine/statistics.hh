@@ -37,6 +37,10 @@ public:
   /// Number of disk write requests.
   unsigned long numDiskWrites;
 
+  /// Number of sectors transferred by those requests.
+  unsigned long numDiskSectorsRead;
+  unsigned long numDiskSectorsWritten;
+
   /// Number of characters read from the keyboard.
   unsigned long numConsoleCharsRead;
 
@@ -49,6 +53,21 @@ public:
   unsigned long numSwapOutPages;
   unsigned long numSwapInPages;
 
+  /// Number of sector lookups satisfied by the block cache.
+  unsigned long numCacheHits;
+
+  /// Number of sector lookups that needed a buffer of their own.
+  unsigned long numCacheMisses;
+
+  /// Number of sectors read into the block cache ahead of time.
+  unsigned long numReadAheads;
+
+  /// Number of groups of operations committed to the journal.
+  unsigned long numJournalCommits;
+
+  /// Number of sectors written to the journal.
+  unsigned long numJournalSectors;
+
 #ifdef DFS_TICKS_FIX
   /// Number of times the tick count gets reset.
   unsigned long tickResets;
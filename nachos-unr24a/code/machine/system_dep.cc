@@ -181,6 +181,88 @@ Tell(int fd)
 #endif
 }
 
+void
+ResizeFile(int fd, size_t nBytes)
+{
+    int retVal = ftruncate(fd, nBytes);
+    ASSERT(retVal == 0);
+}
+
+/// Abort on error.
+void
+ReadAt(int fd, char *buffer, size_t nBytes, size_t offset)
+{
+    ASSERT(buffer != nullptr);
+    ASSERT(nBytes > 0);
+    ssize_t retVal = pread(fd, buffer, nBytes, offset);
+    ASSERT(retVal >= 0);
+    if ((size_t) retVal < nBytes) {
+        memset(buffer + retVal, 0, nBytes - retVal);
+    }
+}
+
+/// Abort on error.
+void
+WriteAt(int fd, const char *buffer, size_t nBytes, size_t offset)
+{
+    ASSERT(buffer != nullptr);
+    ASSERT(nBytes > 0);
+    ssize_t retVal = pwrite(fd, buffer, nBytes, offset);
+    ASSERT(retVal == (ssize_t) nBytes);
+}
+
+int
+OpenForReadWriteDirect(const char *name)
+{
+    ASSERT(name != nullptr);
+#ifdef O_DIRECT
+    return open(name, O_RDWR | O_DIRECT, 0);
+#else
+    return -1;
+#endif
+}
+
+char *
+AllocAligned(size_t size)
+{
+    void *p;
+    int retVal = posix_memalign(&p, DIRECT_IO_ALIGNMENT, size);
+    ASSERT(retVal == 0);
+    return (char *) p;
+}
+
+void
+DeallocAligned(char *p)
+{
+    free(p);
+}
+
+/// Abort on error.
+char *
+MapFile(int fd, size_t nBytes)
+{
+    void *address = mmap(nullptr, nBytes, PROT_READ | PROT_WRITE,
+                         MAP_SHARED, fd, 0);
+    ASSERT(address != MAP_FAILED);
+    return (char *) address;
+}
+
+void
+SyncMapping(char *address, size_t nBytes)
+{
+    ASSERT(address != nullptr);
+    int retVal = msync(address, nBytes, MS_SYNC);
+    ASSERT(retVal == 0);
+}
+
+void
+UnmapFile(char *address, size_t nBytes)
+{
+    ASSERT(address != nullptr);
+    int retVal = munmap(address, nBytes);
+    ASSERT(retVal == 0);
+}
+
 /// Close a file.
 ///
 /// Abort on error.
@@ -17,6 +17,9 @@
 
 
 namespace SystemDep {
+    /// Alignment required by unbuffered (direct) file I/O.
+    const size_t DIRECT_IO_ALIGNMENT = 4096;
+
     /// Check file to see if there are any characters to be read.
     ///
     /// If no characters in the file, return without waiting.
@@ -41,6 +44,37 @@ namespace SystemDep {
 
     int Tell(int fd);
 
+    /// Make the file `nBytes` long.
+    void ResizeFile(int fd, size_t nBytes);
+
+    /// Read/write at `offset` without moving the location within the file.
+    ///
+    /// For files opened with `OpenForReadWriteDirect`, buffer, size and
+    /// offset must be multiples of `DIRECT_IO_ALIGNMENT`.  Reading past
+    /// the end of the file fills `buffer` with zeros.
+
+    void ReadAt(int fd, char *buffer, size_t nBytes, size_t offset);
+
+    void WriteAt(int fd, const char *buffer, size_t nBytes, size_t offset);
+
+    /// Open a file bypassing the buffers of the host, or return -1 if the
+    /// host cannot do that for it.
+    int OpenForReadWriteDirect(const char *name);
+
+    /// Allocate, de-allocate a buffer aligned for the above.
+    char *AllocAligned(size_t size);
+
+    void DeallocAligned(char *p);
+
+    /// Map the first `nBytes` of a file into memory, shared: what is stored
+    /// there ends up in the file.  `SyncMapping` waits until it is written.
+
+    char *MapFile(int fd, size_t nBytes);
+
+    void SyncMapping(char *address, size_t nBytes);
+
+    void UnmapFile(char *address, size_t nBytes);
+
     void Close(int fd);
 
     bool Unlink(const char *name);
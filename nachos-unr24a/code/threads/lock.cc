@@ -15,21 +15,24 @@
 /// limitation of liability and disclaimer of warranty provisions.
 
 #include "lock.hh"
+#include "system.hh"
 #include <stdio.h>
 
-extern Thread *currentThread;
 /// Dummy functions -- so we can compile our later assignments.
 
 Lock::Lock(const char *debugName)
 {
   name = debugName;
+  lockOwner = nullptr;
   sem = new Semaphore(debugName, 1);
+  waiters = new List<Thread *>;
 }
 
 Lock::~Lock()
 {
   DEBUG('z', "Destructor de Lock %s\n", name);
   delete sem;
+  delete waiters;
 }
 
 const char *
@@ -48,24 +51,63 @@ void Lock::Acquire()
     es decir, como tal cualquiera podria utilizar el metodo V(), por lo que no es necesario tener almacenados a los dueños a los que "hayan pasado" por el metodo P(). Por lo tanto, seria imposible localizar a alguno de esto y por lo tanto no se les podria actualizar la prioridad
 
   */
+  // Con las interrupciones deshabilitadas, nadie puede tomar ni soltar el
+  // lock entre que miramos al dueño y nos dormimos en el semaforo.
+  IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
   if (lockOwner)
   {
     DEBUG('p', "Actual de prioridad de lockOwner %s con prioridad %d, new %d \n", lockOwner->GetName(), lockOwner->GetPriority(), currentThread->GetPriority());
 
-    if (currentThread->GetPriority() > lockOwner->GetPriority())
-      lockOwner->SetPriority(currentThread->GetPriority());
+    // La donacion sigue la cadena de dueños bloqueados en otros locks.
+    waiters->Append(currentThread);
+    currentThread->SetWaitingOn(this);
+    lockOwner->DonatePriority(currentThread->GetPriority());
+    sem->P();
+    currentThread->SetWaitingOn((Lock *)nullptr);
+    waiters->Remove(currentThread);
   }
-  sem->P();
+  else
+    sem->P();
   lockOwner = currentThread;
+  currentThread->AcquiredLock(this);
+  // El semaforo despierta en orden de llegada, asi que puede quedar
+  // esperando alguien de mayor prioridad que el nuevo dueño.
+  currentThread->RecomputePriority();
+  interrupt->SetLevel(oldLevel);
 }
 
 void Lock::Release()
 {
   DEBUG('l', "%s intenta liberar el lock: %s\n", currentThread->GetName(), name);
   ASSERT(IsHeldByCurrentThread());
-  lockOwner->SetOriginalPriority();
+  IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
   lockOwner = NULL;
+  // Solo se pierde lo donado a traves de este lock; puede seguir teniendo
+  // otros locks con hilos de mayor prioridad esperando.
+  currentThread->ReleasedLock(this);
+  currentThread->RecomputePriority();
   sem->V();
+  interrupt->SetLevel(oldLevel);
+}
+
+Thread *Lock::GetOwner() const
+{
+  return lockOwner;
+}
+
+static void
+MaxPriority(Thread *t, void *max_)
+{
+  int *max = (int *)max_;
+  if (t->GetPriority() > *max)
+    *max = t->GetPriority();
+}
+
+int Lock::MaxWaitingPriority()
+{
+  int max = -1;
+  waiters->Apply(MaxPriority, &max);
+  return max;
 }
 
 bool Lock::IsHeldByCurrentThread() const
@@ -54,6 +54,13 @@ public:
   /// Useful for checks in `Release` and in condition variables.
   bool IsHeldByCurrentThread() const;
 
+  /// For priority inheritance.
+
+  Thread *GetOwner() const;
+
+  /// Highest priority among the threads blocked on the lock; -1 if none.
+  int MaxWaitingPriority();
+
 private:
   /// For debugging.
   const char *name;
@@ -61,6 +68,7 @@ private:
   // Add other needed fields here.
   Thread *lockOwner;
   Semaphore *sem;
+  List<Thread *> *waiters; ///< Threads blocked in `Acquire`.
 };
 
 #endif
@@ -11,10 +11,12 @@
 /// =====
 ///
 ///     nachos [-d <debugflags>] [-do <debugopts>]
-///            [-rs <random seed #>] [-z] [-tt|-tN]
+///            [-rs <random seed #>] [-sp <num stacks>] [-z] [-tt|-tN]
 ///            [-m <num phys pages>]
 ///            [-s] [-x <nachos file>] [-tc <consoleIn> <consoleOut>]
-///            [-f] [-cp <unix file> <nachos file>] [-pr <nachos file>]
+///            [-f] [-g <sectors per track> <tracks>]
+///            [-dio mmap|syscall|direct]
+///            [-cp <unix file> <nachos file>] [-pr <nachos file>]
 ///            [-rm <nachos file>] [-ls] [-D] [-c] [-tf]
 ///
 /// General options
@@ -25,6 +27,7 @@
 /// * `-do` -- enables options that modify the behavior when printing
 ///            debugging messages.
 /// * `-rs` -- causes `Yield` to occur at random (but repeatable) spots.
+/// * `-sp` -- number of thread stacks to preallocate at boot.
 /// * `-z`  -- prints version and copyright information, and exits.
 /// * `-m`  -- size of emulated physical memory (in pages)
 ///
@@ -46,6 +49,11 @@
 /// -----------------
 ///
 /// * `-f`  -- causes the physical disk to be formatted.
+/// * `-g`  -- geometry of the disk to format, 32 tracks of 32 sectors if
+///            not given.  Otherwise the one it was formatted with is used.
+/// * `-dio` -- how the `DISK` file is accessed: mapped into memory (the
+///            default), with a system call per sector, or with a system
+///            call bypassing the host buffers.  Simulated times are the same.
 /// * `-cp` -- copies a file from UNIX to Nachos.
 /// * `-pr` -- prints a Nachos file to standard output.
 /// * `-rm` -- removes a Nachos file from the file system.
@@ -204,6 +212,11 @@ int main(int argc, char **argv)
 #endif
   }
 
+#ifdef FILESYS
+  // Do not leave the changes made above waiting for the flusher, nor in
+  // the journal, nor sectors taken ahead for files left open.
+  fileSystem->Shutdown();
+#endif
   currentThread->Finish();
   // NOTE: if the procedure `main` returns, then the program `nachos`
   // will exit (as any other normal program would).  But there may be
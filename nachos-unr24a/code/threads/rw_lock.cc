@@ -0,0 +1,210 @@
+/// Routines for reader-writer locks.
+///
+/// Copyright (c) 1992-1993 The Regents of the University of California.
+///               2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#include "rw_lock.hh"
+#include "system.hh"
+
+RWLock::RWLock(const char *debugName, bool prefer)
+{
+  name = debugName;
+  preferWriters = prefer;
+  lock = new Lock(debugName);
+  readOk = new Condition("rwlock read ok", lock);
+  writeOk = new Condition("rwlock write ok", lock);
+  readers = 0;
+  holders = new List<Thread *>;
+  writersWaiting = 0;
+  writer = nullptr;
+  writerReads = 0;
+  waiters = new List<Thread *>;
+}
+
+RWLock::~RWLock()
+{
+  delete readOk;
+  delete writeOk;
+  delete lock;
+  delete waiters;
+  delete holders;
+}
+
+const char *
+RWLock::GetName() const
+{
+  return name;
+}
+
+void RWLock::StartWaiting()
+{
+  waiters->Append(currentThread);
+  currentThread->SetWaitingOn(this);
+}
+
+/// Called again every time the waiter wakes up and has to keep waiting,
+/// since by then the lock may have a different writer.
+void RWLock::Donate()
+{
+  if (writer != nullptr && currentThread->GetPriority() > writer->GetPriority())
+  {
+    DEBUG('p', "%s lends priority %d to writer %s of %s\n", currentThread->GetName(),
+          currentThread->GetPriority(), writer->GetName(), name);
+    writer->DonatePriority(currentThread->GetPriority());
+  }
+}
+
+void RWLock::DoneWaiting()
+{
+  currentThread->SetWaitingOn((RWLock *)nullptr);
+  waiters->Remove(currentThread);
+}
+
+void RWLock::BecomeWriter()
+{
+  writer = currentThread;
+  currentThread->AcquiredLock(this);
+}
+
+/// Drop the write hold, along with whatever priority was lent through it.
+void RWLock::StopBeingWriter()
+{
+  writer = nullptr;
+  currentThread->ReleasedLock(this);
+  currentThread->RecomputePriority();
+}
+
+void RWLock::AcquireRead()
+{
+  lock->Acquire();
+  if (writer == currentThread)
+  {
+    writerReads++;
+    lock->Release();
+    return;
+  }
+  if (writer != nullptr || (preferWriters && writersWaiting > 0))
+  {
+    StartWaiting();
+    while (writer != nullptr || (preferWriters && writersWaiting > 0))
+    {
+      Donate();
+      readOk->Wait();
+    }
+    DoneWaiting();
+  }
+  readers++;
+  holders->Append(currentThread);
+  DEBUG('s', "%s acquires %s for reading (%u readers)\n", currentThread->GetName(), name, readers);
+  lock->Release();
+}
+
+void RWLock::ReleaseRead()
+{
+  lock->Acquire();
+  if (writer == currentThread)
+  {
+    ASSERT(writerReads > 0);
+    writerReads--;
+    lock->Release();
+    return;
+  }
+  ASSERT(readers > 0 && holders->Has(currentThread));
+  readers--;
+  holders->Remove(currentThread);
+  if (readers == 0 && writersWaiting > 0)
+    writeOk->Signal();
+  lock->Release();
+}
+
+void RWLock::AcquireWrite()
+{
+  lock->Acquire();
+  ASSERT(writer != currentThread);
+  writersWaiting++;
+  if (writer != nullptr || readers > 0)
+  {
+    StartWaiting();
+    while (writer != nullptr || readers > 0)
+    {
+      Donate();
+      writeOk->Wait();
+    }
+    DoneWaiting();
+  }
+  writersWaiting--;
+  BecomeWriter();
+  DEBUG('s', "%s acquires %s for writing\n", currentThread->GetName(), name);
+  lock->Release();
+}
+
+void RWLock::ReleaseWrite()
+{
+  lock->Acquire();
+  ASSERT(writer == currentThread);
+  ASSERT(writerReads == 0);
+  StopBeingWriter();
+  if (writersWaiting > 0)
+    writeOk->Signal();
+  if (writersWaiting == 0 || !preferWriters)
+    readOk->Broadcast();
+  lock->Release();
+}
+
+bool RWLock::TryUpgrade()
+{
+  lock->Acquire();
+  ASSERT(writer == nullptr && readers > 0);
+  bool upgraded = readers == 1 && holders->Has(currentThread);
+  if (upgraded)
+  {
+    readers = 0;
+    holders->Remove(currentThread);
+    BecomeWriter();
+    DEBUG('s', "%s upgrades %s\n", currentThread->GetName(), name);
+  }
+  lock->Release();
+  return upgraded;
+}
+
+void RWLock::Downgrade()
+{
+  lock->Acquire();
+  ASSERT(writer == currentThread);
+  ASSERT(writerReads == 0);
+  StopBeingWriter();
+  readers++;
+  holders->Append(currentThread);
+  // Waiting writers still need `readers` to drop to zero, so only readers
+  // can go in now.
+  if (writersWaiting == 0 || !preferWriters)
+    readOk->Broadcast();
+  lock->Release();
+}
+
+Thread *RWLock::GetWriter() const
+{
+  return writer;
+}
+
+static void
+MaxPriority(Thread *t, void *max_)
+{
+  int *max = (int *)max_;
+  if (t->GetPriority() > *max)
+    *max = t->GetPriority();
+}
+
+int RWLock::MaxWaitingPriority()
+{
+  int max = -1;
+  waiters->Apply(MaxPriority, &max);
+  return max;
+}
+
+bool RWLock::IsWriteHeldByCurrentThread() const
+{
+  return writer == currentThread;
+}
@@ -0,0 +1,87 @@
+/// Reader-writer lock, a synchronization primitive.
+///
+/// Copyright (c) 1992-1993 The Regents of the University of California.
+///               2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_THREADS_RWLOCK__HH
+#define NACHOS_THREADS_RWLOCK__HH
+
+#include "condition.hh"
+
+/// This class defines a “reader-writer lock”.
+///
+/// Any number of threads can hold it in shared (read) mode at the same
+/// time, but a thread holding it in exclusive (write) mode excludes
+/// everyone else:
+///
+/// * `AcquireRead`/`ReleaseRead` -- shared access.
+/// * `AcquireWrite`/`ReleaseWrite` -- exclusive access.
+/// * `TryUpgrade` -- turn a read hold into a write hold, if the caller is
+///   the only reader.
+/// * `Downgrade` -- turn a write hold into a read hold.
+///
+/// With writer preference (the default), new readers wait as long as a
+/// writer is waiting, so that a stream of readers cannot starve writers.
+/// The writer may also take the lock for reading; those reads nest inside
+/// the write.  As with `Lock`, a thread that blocks behind the writer lends
+/// it its priority.
+class RWLock
+{
+public:
+  RWLock(const char *debugName, bool preferWriters = true);
+
+  ~RWLock();
+
+  const char *GetName() const;
+
+  void AcquireRead();
+  void ReleaseRead();
+
+  void AcquireWrite();
+  void ReleaseWrite();
+
+  /// Returns `true` if the read hold became a write hold.  Otherwise the
+  /// caller still holds the lock for reading.  A thread that holds no
+  /// share of the lock never upgrades, even if someone else is the lone
+  /// reader.
+  bool TryUpgrade();
+
+  void Downgrade();
+
+  bool IsWriteHeldByCurrentThread() const;
+
+  /// For priority inheritance.
+
+  Thread *GetWriter() const;
+
+  /// Highest priority among the threads blocked on the lock; -1 if none.
+  int MaxWaitingPriority();
+
+private:
+  const char *name;
+  bool preferWriters;
+
+  Lock *lock;
+  Condition *readOk;
+  Condition *writeOk;
+
+  unsigned readers;        ///< Threads holding the lock for reading.
+  List<Thread *> *holders; ///< Those threads, once per share held.
+  unsigned writersWaiting; ///< Threads blocked in `AcquireWrite`.
+  Thread *writer;          ///< Holder in write mode, if any.
+  unsigned writerReads;    ///< Reads nested inside the write hold.
+  List<Thread *> *waiters; ///< Threads blocked in either `Acquire`.
+
+  /// Bookkeeping around blocking, so that the writer (and whoever it is
+  /// blocked behind) inherits the priority of the waiters.
+  void StartWaiting();
+  void Donate();
+  void DoneWaiting();
+
+  void BecomeWriter();
+  void StopBeingWriter();
+};
+
+#endif
@@ -22,9 +22,6 @@
 
 #include <stdio.h>
 
-const int MAXPRIORITY = 9;
-const int QUEUESAMOUNT = MAXPRIORITY + 1;
-
 /// Initialize the list of ready but not running threads to empty.
 Scheduler::Scheduler()
 {
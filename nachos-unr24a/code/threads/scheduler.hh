@@ -13,6 +13,10 @@
 #include "thread.hh"
 #include "lib/list.hh"
 
+/// Highest thread priority; priorities go from 0 to `MAXPRIORITY`.
+const int MAXPRIORITY = 9;
+const int QUEUESAMOUNT = MAXPRIORITY + 1;
+
 /// The following class defines the scheduler/dispatcher abstraction --
 /// the data structures and operations needed to keep track of which
 /// thread is running, and which threads are ready but not running.
@@ -42,7 +46,7 @@ public:
 
 private:
   // Queue of threads that are ready to run, but not running.
-  List<Thread *> *readyList[10];
+  List<Thread *> *readyList[QUEUESAMOUNT];
 };
 
 #endif
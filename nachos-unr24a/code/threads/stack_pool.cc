@@ -0,0 +1,84 @@
+/// Routines to manage the pool of thread stacks.
+///
+/// Copyright (c) 1992-1993 The Regents of the University of California.
+///               2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#include "stack_pool.hh"
+#include "thread.hh"
+#include "lib/utility.hh"
+#include "machine/system_dep.hh"
+
+StackPool::StackPool()
+{
+  for (unsigned c = 0; c < NUM_STACK_CLASSES; c++)
+    numFree[c] = 0;
+}
+
+StackPool::~StackPool()
+{
+  for (unsigned c = 0; c < NUM_STACK_CLASSES; c++)
+    while (numFree[c] > 0)
+      Deallocate(freeStacks[c][--numFree[c]], STACK_SIZE << c);
+}
+
+unsigned StackPool::ClassOf(unsigned words)
+{
+  unsigned c = 0;
+  while (c < NUM_STACK_CLASSES && (STACK_SIZE << c) < words)
+    c++;
+  return c;
+}
+
+void StackPool::Preallocate(unsigned words, unsigned count)
+{
+  unsigned c = ClassOf(words);
+  ASSERT(c < NUM_STACK_CLASSES);
+
+  while (count-- > 0 && numFree[c] < MAX_CACHED_STACKS)
+    freeStacks[c][numFree[c]++] = Allocate(STACK_SIZE << c);
+}
+
+uintptr_t *StackPool::Get(unsigned words, unsigned *size)
+{
+  ASSERT(size != nullptr);
+
+  unsigned c = ClassOf(words);
+  if (c == NUM_STACK_CLASSES)
+  {
+    *size = words;
+    return Allocate(words);
+  }
+
+  *size = STACK_SIZE << c;
+  if (numFree[c] == 0)
+  {
+    DEBUG('t', "Stack pool: class %u empty, allocating\n", c);
+    return Allocate(*size);
+  }
+  return freeStacks[c][--numFree[c]];
+}
+
+void StackPool::Put(uintptr_t *stack, unsigned size)
+{
+  ASSERT(stack != nullptr);
+
+  unsigned c = ClassOf(size);
+  if (c == NUM_STACK_CLASSES || (STACK_SIZE << c) != size || numFree[c] == MAX_CACHED_STACKS)
+  {
+    Deallocate(stack, size);
+    return;
+  }
+  freeStacks[c][numFree[c]++] = stack;
+}
+
+uintptr_t *StackPool::Allocate(unsigned words)
+{
+  return (uintptr_t *)SystemDep::AllocBoundedArray(words * sizeof(uintptr_t));
+}
+
+void StackPool::Deallocate(uintptr_t *stack, unsigned words)
+{
+  SystemDep::DeallocBoundedArray((char *)stack, words * sizeof(uintptr_t));
+}
@@ -0,0 +1,60 @@
+/// A pool of recycled thread execution stacks.
+///
+/// Allocating a stack for every forked thread (and releasing it when the
+/// thread is destroyed) is expensive on the host, so stacks are kept in a
+/// set of size classes and handed back out on the next `Fork`.
+///
+/// Copyright (c) 1992-1993 The Regents of the University of California.
+///               2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_THREADS_STACKPOOL__HH
+#define NACHOS_THREADS_STACKPOOL__HH
+
+#include <stdint.h>
+
+/// Number of size classes.  Class `i` holds stacks of `STACK_SIZE << i`
+/// words; bigger requests are allocated directly and never cached.
+const unsigned NUM_STACK_CLASSES = 4;
+
+/// Maximum number of idle stacks kept in each class.
+const unsigned MAX_CACHED_STACKS = 16;
+
+/// Number of stacks of the smallest class allocated at boot, unless
+/// overridden with `-sp`.
+const unsigned STACK_POOL_PREALLOC = 8;
+
+class StackPool
+{
+public:
+  StackPool();
+
+  /// Release every cached stack.
+  ~StackPool();
+
+  /// Fill the pool with `count` stacks able to hold `words` words.
+  void Preallocate(unsigned words, unsigned count);
+
+  /// Get a stack of at least `words` words.
+  ///
+  /// The size actually provided is stored in `size`, and must be handed
+  /// back to `Put`.
+  uintptr_t *Get(unsigned words, unsigned *size);
+
+  /// Give back a stack obtained from `Get`.
+  void Put(uintptr_t *stack, unsigned size);
+
+  /// Size class a request of `words` words falls into, or
+  /// `NUM_STACK_CLASSES` if it is too big to be pooled.
+  static unsigned ClassOf(unsigned words);
+
+private:
+  uintptr_t *freeStacks[NUM_STACK_CLASSES][MAX_CACHED_STACKS];
+  unsigned numFree[NUM_STACK_CLASSES];
+
+  static uintptr_t *Allocate(unsigned words);
+  static void Deallocate(uintptr_t *stack, unsigned words);
+};
+
+#endif
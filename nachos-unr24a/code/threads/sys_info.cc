@@ -3,6 +3,10 @@
 #include "filesys/directory_entry.hh"
 #include "filesys/file_system.hh"
 #include "filesys/raw_file_header.hh"
+#ifdef FILESYS
+#include "filesys/disk_layout.hh"
+#include "filesys/synch_disk.hh"
+#endif
 
 #include <stdio.h>
 
@@ -10,8 +14,6 @@
 #include "machine/mmu.hh"
 
 static const unsigned MAGIC_SIZE = sizeof(int);
-
-static const unsigned DISK_SIZE = MAGIC_SIZE + NUM_SECTORS * SECTOR_SIZE;
 // #include "machine/statistics.hh"
 // extern Statistics *stats; ///< Performance metrics.
 
@@ -57,6 +59,16 @@ void SysInfo()
 #endif
       ;
 
+#ifdef FILESYS
+  const unsigned sectorsPerTrack = synchDisk->GetSectorsPerTrack();
+  const unsigned numSectors = synchDisk->GetNumSectors();
+  const unsigned freeMapSize = FreeMapSize(numSectors);
+#else
+  const unsigned sectorsPerTrack = DEFAULT_SECTORS_PER_TRACK;
+  const unsigned numSectors = sectorsPerTrack * DEFAULT_NUM_TRACKS;
+  const unsigned freeMapSize = 0;
+#endif
+
   printf("System information.\n");
   printf("\n\
 General:\n\
@@ -80,15 +92,16 @@ Disk:\n\
   Number of tracks: %u.\n\
   Number of sectors: %u.\n\
   Disk size: %u bytes.\n",
-         SECTOR_SIZE, SECTORS_PER_TRACK, NUM_TRACKS, NUM_SECTORS, DISK_SIZE);
+         SECTOR_SIZE, sectorsPerTrack, numSectors / sectorsPerTrack,
+         numSectors, MAGIC_SIZE + numSectors * SECTOR_SIZE);
   printf("\n\
 Filesystem:\n\
   Sectors per header: %u.\n\
   Maximum file size: %u bytes.\n\
   File name maximum length: %u.\n\
   Free sectors map size: %u bytes.\n\
-  Maximum number of dir-entries: %u.\n\
+  Initial number of dir-entries: %u.\n\
   Directory file size: %u bytes.\n",
          NUM_DIRECT, MAX_FILE_SIZE, FILE_NAME_MAX_LEN,
-         FREE_MAP_FILE_SIZE, NUM_DIR_ENTRIES, DIRECTORY_FILE_SIZE);
+         freeMapSize, NUM_DIR_ENTRIES, DIRECTORY_FILE_SIZE);
 }
@@ -26,12 +26,16 @@ Interrupt *interrupt;        ///< Interrupt status.
 Statistics *stats;           ///< Performance metrics.
 Timer *timer;                ///< The hardware timer device, for invoking
                              ///< context switches.
+StackPool *stackPool;        ///< Recycled thread stacks.
 #ifdef FILESYS_NEEDED
 FileSystem *fileSystem;
 #endif
 
 #ifdef FILESYS
 SynchDisk *synchDisk;
+BlockCache *blockCache;
+Journal *journal;
+NameCache *nameCache;
 #endif
 
 #ifdef USER_PROGRAM // Requires either *FILESYS* or *FILESYS_STUB*.
@@ -138,6 +142,7 @@ void Initialize(int argc, char **argv)
   const char *debugFlags = "";
   DebugOpts debugOpts;
   bool randomYield = false;
+  unsigned preallocStacks = STACK_POOL_PREALLOC;
 
 #ifdef USER_PROGRAM
   bool debugUserProg = false; // Single step user program.
@@ -147,6 +152,11 @@ void Initialize(int argc, char **argv)
 #ifdef FILESYS_NEEDED
   bool format = false; // Format disk.
 #endif
+#ifdef FILESYS
+  unsigned sectorsPerTrack = DEFAULT_SECTORS_PER_TRACK;
+  unsigned numTracks = DEFAULT_NUM_TRACKS;
+  DiskMode diskMode = DISK_MAPPED;
+#endif
 
   for (argc--, argv++; argc > 0; argc -= argCount, argv += argCount)
   {
@@ -178,6 +188,12 @@ void Initialize(int argc, char **argv)
       randomYield = true;
       argCount = 2;
     }
+    else if (!strcmp(*argv, "-sp"))
+    {
+      ASSERT(argc > 1);
+      preallocStacks = atoi(*(argv + 1));
+      argCount = 2;
+    }
 #ifdef USER_PROGRAM
     if (!strcmp(*argv, "-s"))
     {
@@ -196,6 +212,27 @@ void Initialize(int argc, char **argv)
     {
       format = true;
     }
+#endif
+#ifdef FILESYS
+    if (!strcmp(*argv, "-g"))
+    {
+      ASSERT(argc > 2);
+      sectorsPerTrack = atoi(*(argv + 1));
+      numTracks = atoi(*(argv + 2));
+      ASSERT(sectorsPerTrack > 0 && numTracks > 0);
+      argCount = 3;
+    }
+    else if (!strcmp(*argv, "-dio"))
+    {
+      ASSERT(argc > 1);
+      if (!strcmp(*(argv + 1), "syscall"))
+        diskMode = DISK_SYSCALL;
+      else if (!strcmp(*(argv + 1), "direct"))
+        diskMode = DISK_DIRECT;
+      else
+        ASSERT(!strcmp(*(argv + 1), "mmap"));
+      argCount = 2;
+    }
 #endif
   }
 
@@ -204,6 +241,8 @@ void Initialize(int argc, char **argv)
   stats = new Statistics;     // Collect statistics.
   interrupt = new Interrupt;  // Start up interrupt handling.
   scheduler = new Scheduler;  // Initialize the ready queue.
+  stackPool = new StackPool;  // Stacks for forked threads.
+  stackPool->Preallocate(STACK_SIZE, preallocStacks);
   if (randomYield)
   { // Start the timer (if needed).
     timer = new Timer(TimerInterruptHandler, 0, randomYield);
@@ -235,7 +274,11 @@ void Initialize(int argc, char **argv)
 #endif
 
 #ifdef FILESYS
-  synchDisk = new SynchDisk("DISK");
+  // Without formatting, the geometry is read from the disk later on.
+  synchDisk = new SynchDisk("DISK", sectorsPerTrack, numTracks, diskMode);
+  blockCache = new BlockCache(synchDisk);
+  journal = new Journal(synchDisk);
+  nameCache = new NameCache;
 #endif
 
 #ifdef FILESYS_NEEDED
@@ -258,6 +301,10 @@ void Cleanup()
 #endif
 
 #ifdef FILESYS
+  delete nameCache;
+  delete journal;
+  journal = nullptr;
+  delete blockCache;
   delete synchDisk;
 #endif
 
@@ -271,6 +318,7 @@ void Cleanup()
   Thread *t = currentThread;
   currentThread = NULL;
   delete t;
+  delete stackPool;
 #ifdef PRPOLICY_FIFO
   delete fifoList;
 #endif
@@ -29,6 +29,8 @@ extern Scheduler *scheduler;        ///< The ready list.
 extern Interrupt *interrupt;        ///< Interrupt status.
 extern Statistics *stats;           ///< Performance metrics.
 extern Timer *timer;                ///< The hardware alarm clock.
+#include "stack_pool.hh"
+extern StackPool *stackPool;        ///< Recycled thread stacks.
 
 #ifdef USER_PROGRAM
 #include "machine/machine.hh"
@@ -50,6 +52,12 @@ extern FileSystem *fileSystem;
 #ifdef FILESYS
 #include "filesys/synch_disk.hh"
 extern SynchDisk *synchDisk;
+#include "filesys/block_cache.hh"
+extern BlockCache *blockCache;
+#include "filesys/journal.hh"
+extern Journal *journal;
+#include "filesys/name_cache.hh"
+extern NameCache *nameCache;
 #endif
 #ifdef SWAP
 extern unsigned nextVictim;
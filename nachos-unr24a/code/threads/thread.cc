@@ -24,6 +24,8 @@
 #include <stdio.h>
 
 #include "channel.hh"
+#include "lock.hh"
+#include "rw_lock.hh"
 /// This is put at the top of the execution stack, for detecting stack
 /// overflows.
 const unsigned STACK_FENCEPOST = 0xDEADBEEF;
@@ -47,12 +49,17 @@ Thread::Thread(const char *threadName, bool join, int p)
   name = threadName;
   stackTop = nullptr;
   stack = nullptr;
+  stackSize = STACK_SIZE;
   status = JUST_CREATED;
 
   isJoinUsed = join;
   finalizedThread = new Channel("threadFinalizedThread");
   currentPriority = p;
   originalPriority = p;
+  heldLocks = new List<Lock *>;
+  heldRWLocks = new List<RWLock *>;
+  waitingLock = nullptr;
+  waitingRWLock = nullptr;
 
 #ifdef USER_PROGRAM
   space = nullptr;
@@ -80,16 +87,19 @@ Thread::~Thread()
 
   if (stack != nullptr)
   {
-    SystemDep::DeallocBoundedArray((char *)stack,
-                                   STACK_SIZE * sizeof *stack);
+    stackPool->Put(stack, stackSize);
   }
 
   if (isJoinUsed)
     delete finalizedThread;
 
+  ASSERT(heldLocks->IsEmpty() && heldRWLocks->IsEmpty());
+  delete heldLocks;
+  delete heldRWLocks;
+
 #ifdef USER_PROGRAM
 
-  for (unsigned i = 2; i < fileDescriptors->SIZE; i++)
+  for (unsigned i = 2; i < fileDescriptors->Size(); i++)
     if (fileDescriptors->HasKey(i))
       delete fileDescriptors->Remove(i);
 
@@ -167,6 +177,13 @@ void Thread::CheckOverflow() const
   }
 }
 
+void Thread::SetStackSize(unsigned words)
+{
+  ASSERT(stack == nullptr);
+  ASSERT(words > 0);
+  stackSize = words;
+}
+
 void Thread::SetStatus(ThreadStatus st)
 {
   ASSERT(IsThreadStatus(st));
@@ -312,11 +329,11 @@ void Thread::StackAllocate(VoidFunctionPtr func, void *arg)
 {
   ASSERT(func != nullptr);
 
-  stack = (uintptr_t *)
-      SystemDep::AllocBoundedArray(STACK_SIZE * sizeof *stack);
+  // Recycled from a previous thread whenever possible.
+  stack = stackPool->Get(stackSize, &stackSize);
 
   // Stacks in x86 work from high addresses to low addresses.
-  stackTop = stack + STACK_SIZE - 4; // -4 to be on the safe side!
+  stackTop = stack + stackSize - 4; // -4 to be on the safe side!
 
   // x86 passes the return address on the stack.  In order for `SWITCH` to
   // go to `ThreadRoot` when we switch to this thread, the return address
@@ -335,10 +352,19 @@ void Thread::StackAllocate(VoidFunctionPtr func, void *arg)
 void Thread::SetPriority(int newPriority)
 {
   ASSERT(this != currentThread);
-  scheduler->Remove(this);
   DEBUG('p', "Cambio de prioridad de %d a %d por parte de %s \n", newPriority, currentPriority, name);
-  currentPriority = newPriority;
-  scheduler->ReadyToRun(this);
+  // Only a ready thread sits in a ready list; a blocked one picks its new
+  // queue when it is woken up.
+  IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+  if (status == READY)
+  {
+    scheduler->Remove(this);
+    currentPriority = newPriority;
+    scheduler->ReadyToRun(this);
+  }
+  else
+    currentPriority = newPriority;
+  interrupt->SetLevel(oldLevel);
 }
 
 void Thread::SetOriginalPriority()
@@ -346,6 +372,97 @@ void Thread::SetOriginalPriority()
   currentPriority = originalPriority;
 }
 
+Thread *Thread::BlockingOwner() const
+{
+  if (waitingLock != nullptr)
+    return waitingLock->GetOwner();
+  if (waitingRWLock != nullptr)
+    return waitingRWLock->GetWriter();
+  return nullptr;
+}
+
+/// Walk the chain of owners starting at this thread, raising each of them
+/// to `priority`.  Stops as soon as a thread already runs at least that
+/// high, since the rest of the chain was raised when it was.
+void Thread::DonatePriority(int priority)
+{
+  IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+  Thread *t = this;
+  for (unsigned depth = 0; t != nullptr && depth < MAX_DONATION_DEPTH; depth++)
+  {
+    if (t == currentThread || t->currentPriority >= priority)
+      break;
+    t->SetPriority(priority);
+    t = t->BlockingOwner();
+  }
+  interrupt->SetLevel(oldLevel);
+}
+
+static void
+MaxLockDonation(Lock *l, void *max_)
+{
+  int *max = (int *)max_;
+  int p = l->MaxWaitingPriority();
+  if (p > *max)
+    *max = p;
+}
+
+static void
+MaxRWLockDonation(RWLock *l, void *max_)
+{
+  int *max = (int *)max_;
+  int p = l->MaxWaitingPriority();
+  if (p > *max)
+    *max = p;
+}
+
+void Thread::RecomputePriority()
+{
+  IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+  int p = originalPriority;
+  heldLocks->Apply(MaxLockDonation, &p);
+  heldRWLocks->Apply(MaxRWLockDonation, &p);
+  if (p != currentPriority)
+  {
+    DEBUG('p', "Prioridad de %s recalculada: %d -> %d\n", name, currentPriority, p);
+    if (this == currentThread)
+      currentPriority = p;
+    else
+      SetPriority(p);
+  }
+  interrupt->SetLevel(oldLevel);
+}
+
+void Thread::AcquiredLock(Lock *l)
+{
+  heldLocks->Append(l);
+}
+
+void Thread::ReleasedLock(Lock *l)
+{
+  heldLocks->Remove(l);
+}
+
+void Thread::AcquiredLock(RWLock *l)
+{
+  heldRWLocks->Append(l);
+}
+
+void Thread::ReleasedLock(RWLock *l)
+{
+  heldRWLocks->Remove(l);
+}
+
+void Thread::SetWaitingOn(Lock *l)
+{
+  waitingLock = l;
+}
+
+void Thread::SetWaitingOn(RWLock *l)
+{
+  waitingRWLock = l;
+}
+
 #ifdef USER_PROGRAM
 #include "machine/machine.hh"
 
@@ -38,6 +38,7 @@
 #ifndef NACHOS_THREADS_THREAD__HH
 #define NACHOS_THREADS_THREAD__HH
 
+#include "lib/list.hh"
 #include "lib/utility.hh"
 
 #ifdef USER_PROGRAM
@@ -48,7 +49,12 @@
 
 #include <stdint.h>
 class Channel;
+class Lock;
 class OpenFile;
+class RWLock;
+
+/// Longest chain of lock owners a priority donation is propagated along.
+const unsigned MAX_DONATION_DEPTH = 8;
 
 /// CPU register state to be saved on context switch.
 ///
@@ -128,6 +134,11 @@ public:
   /// Check if thread has overflowed its stack.
   void CheckOverflow() const;
 
+  /// Ask for a stack of `words` words instead of `STACK_SIZE`.
+  ///
+  /// Must be called before `Fork`.
+  void SetStackSize(unsigned words);
+
   void SetStatus(ThreadStatus st);
 
   const char *GetName() const;
@@ -138,6 +149,30 @@ public:
 
   int GetPriority();
 
+  /// Priority inheritance.
+  ///
+  /// Every thread keeps track of the locks it holds and of the lock it is
+  /// blocked on, so that a donation can follow a chain of owners, and so
+  /// that releasing one lock only drops the priority lent through it.
+
+  /// Raise this thread to `priority`, and then whoever it is blocked
+  /// behind, and so on.
+  void DonatePriority(int priority);
+
+  /// Recompute the priority from the original one and from the waiters of
+  /// every lock still held.
+  void RecomputePriority();
+
+  void AcquiredLock(Lock *l);
+  void ReleasedLock(Lock *l);
+  void AcquiredLock(RWLock *l);
+  void ReleasedLock(RWLock *l);
+
+  /// Record the lock the thread is about to block on; null once it has
+  /// been acquired.
+  void SetWaitingOn(Lock *l);
+  void SetWaitingOn(RWLock *l);
+
   void Print() const;
 
   Table<OpenFile *> *fileDescriptors;
@@ -150,6 +185,17 @@ private:
   /// Null if this is the main thread.  (If null, do not deallocate stack.)
   uintptr_t *stack;
 
+  /// Size of `stack`, in words.
+  unsigned stackSize;
+
+  List<Lock *> *heldLocks;
+  List<RWLock *> *heldRWLocks; ///< Held for writing.
+  Lock *waitingLock;
+  RWLock *waitingRWLock;
+
+  /// Thread owning the lock this thread is blocked on, if any.
+  Thread *BlockingOwner() const;
+
   /// Ready, running or blocked.
   ThreadStatus status;
 
@@ -18,6 +18,10 @@
 #include "thread_test_scheduler_priority.hh"
 #include "thread_test_join.hh"
 #include "thread_test_channel.hh"
+#include "thread_test_work_queue.hh"
+#include "thread_test_rw_lock.hh"
+#include "thread_test_inheritance.hh"
+#include "thread_test_stack_pool.hh"
 #include "lib/utility.hh"
 
 #include <stdio.h>
@@ -39,7 +43,11 @@ static const Test TESTS[] = {
     {&ThreadTestChannel, "channel", "Channel"},
     {&ThreadTestJoin, "Join", "Test to proof join"},
     {&ThreadTestSchedulerSimple, "SchedulerS", "Scheduler w/o locks"},
-    {&ThreadTestSchedulerPriority, "SchedulerP", "Scheduler w/ locks"}
+    {&ThreadTestSchedulerPriority, "SchedulerP", "Scheduler w/ locks"},
+    {&ThreadTestWorkQueue, "WorkQueue", "Kernel work queue"},
+    {&ThreadTestRWLock, "RWLock", "Readers/writers lock"},
+    {&ThreadTestInheritance, "Inheritance", "Transitive priority inheritance"},
+    {&ThreadTestStackPool, "StackPool", "Threads with bigger stacks"}
 
 };
 static const unsigned NUM_TESTS = sizeof TESTS / sizeof TESTS[0];
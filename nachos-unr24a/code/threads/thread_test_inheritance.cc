@@ -0,0 +1,145 @@
+/// Copyright (c) 1992-1993 The Regents of the University of California.
+///               2007-2009 Universidad de Las Palmas de Gran Canaria.
+///               2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#include "thread_test_inheritance.hh"
+#include "system.hh"
+#include "lock.hh"
+
+#include <stdio.h>
+
+static Lock *a, *b;
+static Semaphore *go;
+static int lowAfterA, midAfterA, midAfterB;
+static unsigned done;
+
+/// Holds `a` until told to go.
+static void Low(void *)
+{
+  a->Acquire();
+  go->P();
+  a->Release();
+  lowAfterA = currentThread->GetPriority();
+  done++;
+}
+
+/// Holds `b` and blocks on `a`.
+static void Mid(void *)
+{
+  b->Acquire();
+  a->Acquire();
+  a->Release();
+  midAfterA = currentThread->GetPriority();
+  b->Release();
+  midAfterB = currentThread->GetPriority();
+  done++;
+}
+
+/// Blocks on `b`.
+static void High(void *)
+{
+  b->Acquire();
+  b->Release();
+  done++;
+}
+
+static Lock *c;
+static Semaphore *go2;
+static int firstWhileHolding;
+
+/// Holds `c` until told to go.
+static void Holder(void *)
+{
+  c->Acquire();
+  go2->P();
+  c->Release();
+  done++;
+}
+
+/// Waits for `c`, the first in line.
+static void FirstWaiter(void *)
+{
+  c->Acquire();
+  firstWhileHolding = currentThread->GetPriority();
+  c->Release();
+  done++;
+}
+
+/// Waits for `c` after `FirstWaiter`.
+static void SecondWaiter(void *)
+{
+  c->Acquire();
+  c->Release();
+  done++;
+}
+
+/// The lock goes to waiters in arrival order, so when a low priority
+/// thread gets it before a high priority one, it must inherit from the
+/// one still waiting.
+static void ThreadTestInheritanceOrder()
+{
+  c = new Lock("c");
+  go2 = new Semaphore("go2", 0);
+  done = 0;
+
+  (new Thread("holder", false, 5))->Fork(Holder, nullptr);
+  currentThread->Yield();
+  (new Thread("first waiter", false, 6))->Fork(FirstWaiter, nullptr);
+  currentThread->Yield();
+  (new Thread("second waiter", false, 8))->Fork(SecondWaiter, nullptr);
+  currentThread->Yield();
+
+  go2->V();
+  while (done < 3)
+    currentThread->Yield();
+
+  printf("first waiter while holding c: %d\n", firstWhileHolding);
+  ASSERT(firstWhileHolding == 8);
+
+  delete c;
+  delete go2;
+}
+
+/// Build the chain high -> b -> mid -> a -> low and check that the
+/// priority of `high` reaches `low`, and that releasing a lock only gives
+/// back what was lent through it.
+void ThreadTestInheritance()
+{
+  a = new Lock("a");
+  b = new Lock("b");
+  go = new Semaphore("go", 0);
+  done = 0;
+
+  Thread *low = new Thread("low", false, 5);
+  Thread *mid = new Thread("mid", false, 6);
+  low->Fork(Low, nullptr);
+  currentThread->Yield();
+  mid->Fork(Mid, nullptr);
+  currentThread->Yield();
+  ASSERT(low->GetPriority() == 6);
+
+  (new Thread("high", false, 7))->Fork(High, nullptr);
+  currentThread->Yield();
+  printf("Priorities with the chain built: low %d, mid %d\n",
+         low->GetPriority(), mid->GetPriority());
+  ASSERT(low->GetPriority() == 7 && mid->GetPriority() == 7);
+
+  go->V();
+  while (done < 3)
+    currentThread->Yield();
+
+  printf("low after releasing a: %d\n", lowAfterA);
+  printf("mid after releasing a: %d, after releasing b: %d\n",
+         midAfterA, midAfterB);
+  ASSERT(lowAfterA == 5);
+  ASSERT(midAfterA == 7 && midAfterB == 6);
+
+  delete a;
+  delete b;
+  delete go;
+
+  ThreadTestInheritanceOrder();
+  printf("Test finished\n");
+}
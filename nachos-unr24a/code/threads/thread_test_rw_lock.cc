@@ -0,0 +1,109 @@
+/// Copyright (c) 1992-1993 The Regents of the University of California.
+///               2007-2009 Universidad de Las Palmas de Gran Canaria.
+///               2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#include "thread_test_rw_lock.hh"
+#include "system.hh"
+#include "rw_lock.hh"
+
+#include <stdio.h>
+
+static RWLock *rw;
+static unsigned inside = 0, maxInside = 0, done = 0;
+static bool writing = false;
+static int writerPriority;
+
+static void Reader(void *n_)
+{
+  rw->AcquireRead();
+  ASSERT(!writing);
+  inside++;
+  if (inside > maxInside)
+    maxInside = inside;
+  printf("*** Reader %s in, %u readers inside\n", currentThread->GetName(), inside);
+  for (unsigned i = 0; i < 3; i++)
+    currentThread->Yield();
+  inside--;
+  rw->ReleaseRead();
+  done++;
+}
+
+static void Writer(void *n_)
+{
+  rw->AcquireWrite();
+  ASSERT(inside == 0);
+  writing = true;
+  printf("*** Writer %s in\n", currentThread->GetName());
+  // The writer may read what it is writing.
+  rw->AcquireRead();
+  rw->ReleaseRead();
+  for (unsigned i = 0; i < 3; i++)
+    currentThread->Yield();
+  writerPriority = currentThread->GetPriority();
+  writing = false;
+  rw->ReleaseWrite();
+  done++;
+}
+
+static void Outsider(void *n_)
+{
+  // Holds no share, so it cannot take the lone reader's.
+  ASSERT(!rw->TryUpgrade());
+  ASSERT(!rw->IsWriteHeldByCurrentThread());
+  done++;
+}
+
+static void WaitFor(unsigned n)
+{
+  while (done < n)
+    currentThread->Yield();
+}
+
+void ThreadTestRWLock()
+{
+  rw = new RWLock("test rwlock");
+
+  // Readers share the lock.
+  (new Thread("r1"))->Fork(Reader, nullptr);
+  (new Thread("r2"))->Fork(Reader, nullptr);
+  (new Thread("r3"))->Fork(Reader, nullptr);
+  WaitFor(3);
+  ASSERT(maxInside > 1);
+
+  // A waiting writer holds back new readers.
+  done = 0;
+  maxInside = 0;
+  rw->AcquireRead();
+  (new Thread("w1"))->Fork(Writer, nullptr);
+  currentThread->Yield();
+  (new Thread("r4"))->Fork(Reader, nullptr);
+  currentThread->Yield();
+  ASSERT(inside == 0 && done == 0);
+  rw->ReleaseRead();
+  WaitFor(2);
+
+  // Upgrades only work for a lone reader.
+  rw->AcquireRead();
+  ASSERT(rw->TryUpgrade());
+  ASSERT(rw->IsWriteHeldByCurrentThread());
+  rw->Downgrade();
+  done = 0;
+  (new Thread("outsider"))->Fork(Outsider, nullptr);
+  WaitFor(1);
+  rw->ReleaseRead();
+
+  // A blocked reader lends its priority to the writer.
+  done = 0;
+  (new Thread("w2"))->Fork(Writer, nullptr);
+  while (!writing)
+    currentThread->Yield();
+  (new Thread("high reader", false, 8))->Fork(Reader, nullptr);
+  WaitFor(2);
+  printf("Writer priority while the reader waited: %d\n", writerPriority);
+  ASSERT(writerPriority == 8);
+
+  delete rw;
+  printf("Test finished\n");
+}
@@ -0,0 +1,69 @@
+/// Copyright (c) 1992-1993 The Regents of the University of California.
+///               2007-2009 Universidad de Las Palmas de Gran Canaria.
+///               2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#include "thread_test_stack_pool.hh"
+#include "system.hh"
+#include "stack_pool.hh"
+
+#include <stdio.h>
+
+/// Words of stack used by `Deep`, more than a default stack holds.
+static const unsigned DEEP_WORDS = 2 * STACK_SIZE;
+
+static unsigned done = 0;
+
+/// Fill a local array bigger than `STACK_SIZE`, and yield with it in use,
+/// so that the fence post at the bottom of the stack gets checked.
+static void Deep(void *n_)
+{
+  uintptr_t words[DEEP_WORDS];
+  for (unsigned i = 0; i < DEEP_WORDS; i++)
+    words[i] = i;
+  currentThread->Yield();
+
+  uintptr_t sum = 0;
+  for (unsigned i = 0; i < DEEP_WORDS; i++)
+    sum += words[i];
+  ASSERT(sum == (uintptr_t)DEEP_WORDS * (DEEP_WORDS - 1) / 2);
+  printf("*** Thread %s used %u words of stack\n", currentThread->GetName(), DEEP_WORDS);
+  done++;
+}
+
+static void Shallow(void *n_)
+{
+  currentThread->Yield();
+  done++;
+}
+
+static void ForkDeep(const char *name)
+{
+  Thread *t = new Thread(name);
+  t->SetStackSize(3 * STACK_SIZE);
+  t->Fork(Deep, nullptr);
+}
+
+void ThreadTestStackPool()
+{
+  // Requests are rounded up to a size class; too big ones are not pooled.
+  ASSERT(StackPool::ClassOf(STACK_SIZE) == 0);
+  ASSERT(StackPool::ClassOf(3 * STACK_SIZE) == 2);
+  ASSERT(StackPool::ClassOf(STACK_SIZE << NUM_STACK_CLASSES) == NUM_STACK_CLASSES);
+
+  // Big and default stacks side by side.
+  ForkDeep("deep 1");
+  (new Thread("shallow 1"))->Fork(Shallow, nullptr);
+  (new Thread("shallow 2"))->Fork(Shallow, nullptr);
+  while (done < 3)
+    currentThread->Yield();
+
+  // Once the first is gone, the next big thread takes its stack back out
+  // of the pool.
+  ForkDeep("deep 2");
+  while (done < 4)
+    currentThread->Yield();
+
+  printf("Test finished\n");
+}
@@ -0,0 +1,14 @@
+/// Copyright (c) 1992-1993 The Regents of the University of California.
+///               2007-2009 Universidad de Las Palmas de Gran Canaria.
+///               2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_THREADS_THREADTESTSTACKPOOL__HH
+#define NACHOS_THREADS_THREADTESTSTACKPOOL__HH
+
+
+void ThreadTestStackPool();
+
+
+#endif
@@ -0,0 +1,59 @@
+/// Copyright (c) 1992-1993 The Regents of the University of California.
+///               2007-2009 Universidad de Las Palmas de Gran Canaria.
+///               2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#include "thread_test_work_queue.hh"
+#include "system.hh"
+#include "work_queue.hh"
+
+#include <stdio.h>
+
+static const unsigned NUM_JOBS = 6;
+
+static WorkQueue *queue;
+static unsigned finished = 0;
+
+static void Job(void *n_)
+{
+  int n = *(int *)n_;
+  printf("*** Job %d running in `%s`\n", n, currentThread->GetName());
+  // Jobs are taken highest priority first, so once a job that is not
+  // urgent has been taken, only others like it can still be queued.  This
+  // holds however the workers are interleaved.
+  if (n % 2 != 0)
+    ASSERT(queue->Pending() < NUM_JOBS / 2);
+  for (unsigned i = 0; i < 3; i++)
+    currentThread->Yield();
+  finished++;
+}
+
+/// Submit jobs of two priorities before any worker gets to run, and check
+/// that the urgent ones are all taken first and that every handle is
+/// signalled.
+void ThreadTestWorkQueue()
+{
+  queue = new WorkQueue("worker", 2);
+  int ids[NUM_JOBS];
+  WorkHandle *handles[NUM_JOBS];
+
+  for (unsigned i = 0; i < NUM_JOBS; i++)
+  {
+    ids[i] = i;
+    // Even jobs are urgent, odd ones are not.
+    handles[i] = queue->Submit(Job, &ids[i], i % 2 == 0 ? 8 : 1);
+  }
+
+  for (unsigned i = 0; i < NUM_JOBS; i++)
+  {
+    handles[i]->Wait();
+    ASSERT(handles[i]->IsDone());
+    handles[i]->Release();
+  }
+  queue->Drain();
+  ASSERT(finished == NUM_JOBS);
+
+  delete queue;
+  printf("Test finished\n");
+}
@@ -0,0 +1,190 @@
+/// Routines for the kernel work queue.
+///
+/// Copyright (c) 1992-1993 The Regents of the University of California.
+///               2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#include "work_queue.hh"
+#include "system.hh"
+
+WorkHandle::WorkHandle(WorkQueue *q)
+{
+  queue = q;
+  done = false;
+  refs = 2;
+}
+
+void WorkHandle::Wait()
+{
+  queue->lock->Acquire();
+  while (!done)
+    queue->jobDone->Wait();
+  queue->lock->Release();
+}
+
+bool WorkHandle::IsDone()
+{
+  queue->lock->Acquire();
+  bool d = done;
+  queue->lock->Release();
+  return d;
+}
+
+void WorkHandle::Release()
+{
+  WorkQueue *q = queue;
+  q->lock->Acquire();
+  q->ReleaseHandle(this);
+  q->lock->Release();
+}
+
+/// Must be called with the queue lock held.
+void WorkQueue::ReleaseHandle(WorkHandle *handle)
+{
+  ASSERT(handle->refs > 0);
+  if (--handle->refs == 0)
+    delete handle;
+}
+
+WorkQueue::WorkQueue(const char *debugName, unsigned n, int priority)
+{
+  ASSERT(n > 0);
+  ASSERT(0 <= priority && priority <= MAXPRIORITY);
+
+  name = debugName;
+  numWorkers = n;
+  workerPriority = priority;
+  workers = nullptr;
+  for (int i = 0; i <= MAXPRIORITY; i++)
+    jobs[i] = new List<Job *>;
+  queued = 0;
+  running = 0;
+  stopping = false;
+  lock = new Lock(debugName);
+  hasWork = new Condition("work queue has work", lock);
+  jobDone = new Condition("work queue job done", lock);
+}
+
+WorkQueue::~WorkQueue()
+{
+  if (workers != nullptr)
+  {
+    lock->Acquire();
+    stopping = true;
+    hasWork->Broadcast();
+    lock->Release();
+    for (unsigned i = 0; i < numWorkers; i++)
+      workers[i]->Join();
+    delete[] workers;
+  }
+
+  for (int i = 0; i <= MAXPRIORITY; i++)
+  {
+    ASSERT(jobs[i]->IsEmpty());
+    delete jobs[i];
+  }
+  delete hasWork;
+  delete jobDone;
+  delete lock;
+}
+
+/// Fork the workers.  Must be called with the queue lock held.
+void WorkQueue::Start()
+{
+  DEBUG('t', "Starting %u workers for work queue %s\n", numWorkers, name);
+  workers = new Thread *[numWorkers];
+  for (unsigned i = 0; i < numWorkers; i++)
+  {
+    workers[i] = new Thread(name, true, workerPriority);
+    workers[i]->Fork(Worker, this);
+  }
+}
+
+void WorkQueue::Enqueue(Job *job, int priority)
+{
+  ASSERT(job->func != nullptr);
+  ASSERT(0 <= priority && priority <= MAXPRIORITY);
+
+  lock->Acquire();
+  if (workers == nullptr)
+    Start();
+  jobs[priority]->Append(job);
+  queued++;
+  hasWork->Signal();
+  lock->Release();
+}
+
+WorkHandle *WorkQueue::Submit(VoidFunctionPtr func, void *arg, int priority)
+{
+  Job *job = new Job;
+  job->func = func;
+  job->arg = arg;
+  job->handle = new WorkHandle(this);
+
+  WorkHandle *handle = job->handle;
+  Enqueue(job, priority);
+  return handle;
+}
+
+void WorkQueue::SubmitDetached(VoidFunctionPtr func, void *arg, int priority)
+{
+  Job *job = new Job;
+  job->func = func;
+  job->arg = arg;
+  job->handle = nullptr;
+  Enqueue(job, priority);
+}
+
+void WorkQueue::Drain()
+{
+  lock->Acquire();
+  while (queued > 0 || running > 0)
+    jobDone->Wait();
+  lock->Release();
+}
+
+unsigned WorkQueue::Pending()
+{
+  lock->Acquire();
+  unsigned n = queued;
+  lock->Release();
+  return n;
+}
+
+/// Body of every worker: take the most urgent job and run it, until the
+/// queue is being destroyed and there is nothing left to do.
+void WorkQueue::Worker(void *queue_)
+{
+  WorkQueue *q = (WorkQueue *)queue_;
+
+  q->lock->Acquire();
+  for (;;)
+  {
+    while (q->queued == 0 && !q->stopping)
+      q->hasWork->Wait();
+    if (q->queued == 0)
+      break;
+
+    Job *job = nullptr;
+    for (int i = MAXPRIORITY; job == nullptr; i--)
+      if (!q->jobs[i]->IsEmpty())
+        job = q->jobs[i]->Pop();
+    q->queued--;
+    q->running++;
+
+    q->lock->Release();
+    job->func(job->arg);
+    q->lock->Acquire();
+
+    q->running--;
+    if (job->handle != nullptr)
+    {
+      job->handle->done = true;
+      q->ReleaseHandle(job->handle);
+    }
+    delete job;
+    q->jobDone->Broadcast();
+  }
+  q->lock->Release();
+}
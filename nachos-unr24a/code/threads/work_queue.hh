@@ -0,0 +1,104 @@
+/// A pool of kernel worker threads fed by a queue of jobs.
+///
+/// Short pieces of deferred kernel work (flushing, asynchronous I/O, ...)
+/// are submitted to a `WorkQueue` instead of forking a new thread for each
+/// of them.  A fixed set of workers takes jobs from the queue, highest
+/// priority first, and runs them to completion.
+///
+/// Copyright (c) 1992-1993 The Regents of the University of California.
+///               2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_THREADS_WORKQUEUE__HH
+#define NACHOS_THREADS_WORKQUEUE__HH
+
+#include "condition.hh"
+#include "scheduler.hh"
+#include "lib/list.hh"
+#include "lib/utility.hh"
+
+class WorkQueue;
+
+/// Lets the submitter of a job wait for it to be done.
+///
+/// Every handle returned by `WorkQueue::Submit` must be given back with
+/// `Release`, whether it was waited on or not.
+class WorkHandle
+{
+public:
+  /// Block until the job has run.
+  void Wait();
+
+  bool IsDone();
+
+  /// The submitter does not need the handle anymore.
+  void Release();
+
+private:
+  friend class WorkQueue;
+
+  WorkHandle(WorkQueue *q);
+
+  WorkQueue *queue;
+  bool done;
+  unsigned refs; ///< One for the submitter, one for the queue.
+};
+
+class WorkQueue
+{
+public:
+  /// Workers are started lazily, on the first `Submit`.
+  WorkQueue(const char *debugName, unsigned numWorkers,
+            int workerPriority = 4);
+
+  /// Run every job still queued and stop the workers.
+  ///
+  /// Must not be called from a worker.
+  ~WorkQueue();
+
+  /// Queue `(*func)(arg)`.  Among queued jobs, those with a higher
+  /// `priority` run first.
+  WorkHandle *Submit(VoidFunctionPtr func, void *arg, int priority = 4);
+
+  /// Queue a job nobody is going to wait for.
+  void SubmitDetached(VoidFunctionPtr func, void *arg, int priority = 4);
+
+  /// Block until every job submitted so far has run.
+  void Drain();
+
+  /// Number of jobs queued and not yet taken by a worker.
+  unsigned Pending();
+
+private:
+  friend class WorkHandle;
+
+  struct Job
+  {
+    VoidFunctionPtr func;
+    void *arg;
+    WorkHandle *handle; ///< Null for detached jobs.
+  };
+
+  const char *name;
+  unsigned numWorkers;
+  int workerPriority;
+  Thread **workers; ///< Null until the first job is submitted.
+
+  List<Job *> *jobs[MAXPRIORITY + 1];
+  unsigned queued;  ///< Jobs in `jobs`.
+  unsigned running; ///< Jobs being run by a worker.
+  bool stopping;
+
+  Lock *lock;
+  Condition *hasWork; ///< Workers wait here for jobs.
+  Condition *jobDone; ///< Broadcast whenever a job finishes.
+
+  void Start();
+  void Enqueue(Job *job, int priority);
+  void ReleaseHandle(WorkHandle *handle);
+
+  static void Worker(void *queue_);
+};
+
+#endif
@@ -167,6 +167,22 @@ Mkdir:
         j       $31
         .end    Mkdir
 
+        .globl  Sync
+        .ent    Sync
+Sync:
+        addiu   $2, $0, SC_SYNC
+        syscall
+        j       $31
+        .end    Sync
+
+        .globl  Fsync
+        .ent    Fsync
+Fsync:
+        addiu   $2, $0, SC_FSYNC
+        syscall
+        j       $31
+        .end    Fsync
+
 
 /// Dummy function to keep gcc happy.
         .globl  __main
@@ -133,6 +133,9 @@ SyscallHandler(ExceptionType _et)
 
   case SC_HALT:
     DEBUG('e', "Shutdown, initiated by user program.\n");
+#ifndef FILESYS_STUB
+    fileSystem->Shutdown();
+#endif
     interrupt->Halt();
     break;
 
@@ -387,12 +390,47 @@ SyscallHandler(ExceptionType _et)
 
     break;
   }
+  case SC_SYNC:
+  {
+    DEBUG('e', "`Sync` requested.\n");
+    blockCache->Sync();
+    journal->Checkpoint();
+    machine->WriteRegister(2, 0);
+    break;
+  }
+  case SC_FSYNC:
+  {
+    OpenFileId fid = machine->ReadRegister(4);
+    DEBUG('e', "`Fsync` requested for fid %d.\n", fid);
+    if (fid == CONSOLE_INPUT || fid == CONSOLE_OUTPUT)
+    {
+      machine->WriteRegister(2, 0);
+      break;
+    }
+    if (fid < 0)
+    {
+      DEBUG('e', "Error: invalid fid %d.\n", fid);
+      machine->WriteRegister(2, -1);
+      break;
+    }
+    OpenFile *file = currentThread->fileDescriptors->Get(fid - 2);
+    if (file != nullptr && fileSystem->Fsync(file->GetId()))
+      machine->WriteRegister(2, 0);
+    else
+      machine->WriteRegister(2, -1);
+    break;
+  }
 #else
   case SC_CD:
   case SC_LS:
   case SC_MKDIR:
     machine->WriteRegister(2, -1);
     break;
+  case SC_SYNC:
+  case SC_FSYNC:
+    // Writes already went to the host file system.
+    machine->WriteRegister(2, 0);
+    break;
 #endif
   default:
     fprintf(stderr, "Unexpected system call: id %d.\n", scid);
@@ -38,6 +38,9 @@
 #define SC_LS 17
 #define SC_MKDIR 18
 
+#define SC_SYNC 19
+#define SC_FSYNC 20
+
 #ifndef IN_ASM
 
 /// The system call interface.  These are the operations the Nachos kernel
@@ -133,6 +136,12 @@ int Ls();
 
 int Mkdir(const char *name);
 
+/// Write every delayed change to the disk.
+void Sync();
+
+/// Write the delayed changes of the open file `id` to the disk.
+int Fsync(OpenFileId id);
+
 #endif
 
 #endif